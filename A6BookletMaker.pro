@@ -1,6 +1,6 @@
 # A6BookletMaker.pro
 
-QT       += core gui widgets
+QT       += core gui widgets concurrent network
 
 TARGET = A6BookletMaker
 TEMPLATE = app
@@ -16,24 +16,22 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # Silence SDK version warnings
 CONFIG += sdk_no_version_check
 
-# Include paths for macOS
-macx {
-    # QPDF include paths - adjust according to your installation
-    INCLUDEPATH += /opt/homebrew/Cellar/qpdf/12.1.0/include
-    
-    # Add library paths
-    LIBS += -L/opt/homebrew/lib -lqpdf
-}
+# The layout pipeline, built once by engine/core/bookletcore.pro
+include(engine/core/bookletcore.pri)
 
 SOURCES += \
+    bookletclient.cpp \
+    bookletdaemon.cpp \
+    hotfolder.cpp \
     main.cpp \
     mainwindow.cpp \
-    pdfbookletcreator.cpp \
     pdfpreviewwidget.cpp
 
 HEADERS += \
+    bookletclient.h \
+    bookletdaemon.h \
+    hotfolder.h \
     mainwindow.h \
-    pdfbookletcreator.h \
     pdfpreviewwidget.h
 
 FORMS += \
@@ -0,0 +1,25 @@
+# A6BookletBench.pro - end-to-end benchmark for the booklet pipeline
+#
+#   (cd ../engine/core && qmake bookletcore.pro && make)
+#   qmake A6BookletBench.pro && make
+#   ./A6BookletBench --pages 8,64 -n 3 -o bench.json
+
+QT       += core gui concurrent
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = A6BookletBench
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+CONFIG += sdk_no_version_check
+
+# The layout pipeline, built once by engine/core/bookletcore.pro
+include(../engine/core/bookletcore.pri)
+
+SOURCES += \
+    benchmain.cpp \
+    corpusgenerator.cpp
+
+HEADERS += \
+    corpusgenerator.h
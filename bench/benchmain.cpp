@@ -0,0 +1,300 @@
+// End-to-end benchmark for the booklet pipeline.
+//
+// Generates a synthetic A6 corpus, runs createBooklet, the layout modes,
+// the preflight, padding, reorder and compile stages on their own and the
+// optimization passes, alone and inside createBooklet, for N iterations
+// each, and prints a JSON report (median/p95 latency, pages per second,
+// output size, per-stage timings from the stage tracer and peak RSS of
+// each case). The defaults are sized for CI; pass --pages 8,64,512,5000
+// --image-dpi 600 for the full corpus.
+
+#include "corpusgenerator.h"
+#include "../pathconfig.h"
+#include "../pdfbookletcreator.h"
+#include "../pdfoptimizer.h"
+#include "../resourcereport.h"
+#include "../spawnhelper.h"
+#include "../stagetracer.h"
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <functional>
+#include <sys/resource.h>
+
+namespace {
+
+double percentile(QList<double> values, double fraction)
+{
+    if (values.isEmpty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    int index = qBound(0, static_cast<int>(fraction * (values.size() - 1) + 0.5), values.size() - 1);
+    return values.at(index);
+}
+
+QJsonObject latencyStats(const QList<double> &milliseconds)
+{
+    QJsonObject stats;
+    stats["median_ms"] = percentile(milliseconds, 0.5);
+    stats["p95_ms"] = percentile(milliseconds, 0.95);
+    stats["samples"] = milliseconds.size();
+    return stats;
+}
+
+// Reset the peak RSS of this process to its current size, so each case
+// reports its own peak. Only Linux can do this; elsewhere the peak only
+// grows and a case reports the largest footprint so far.
+void resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile clearRefs("/proc/self/clear_refs");
+    if (clearRefs.open(QIODevice::WriteOnly)) {
+        clearRefs.write("5");
+    }
+#endif
+}
+
+// Peak resident set size of this process in kilobytes
+qint64 selfPeakRssKb()
+{
+    qint64 peak = ResourceReport::processPeakRssKb(QCoreApplication::applicationPid());
+    if (peak > 0) {
+        return peak;
+    }
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? ResourceReport::maxRssKb(usage) : 0;
+}
+
+// Largest peak RSS of any tool run in a job's resource report
+qint64 toolPeakRssKb(const QJsonObject &report)
+{
+    qint64 peak = 0;
+    const QJsonObject tools = report["tools"].toObject();
+    for (auto it = tools.constBegin(); it != tools.constEnd(); ++it) {
+        peak = qMax(peak, static_cast<qint64>(it.value().toObject()["peak_rss_kb"].toDouble()));
+    }
+    return peak;
+}
+
+// Run one benchmark case and collect timings, stage spans, output size and
+// peak RSS. jobReport receives the creator's resource report of each run
+// (tools are helper-spawned, so the report is the only record of their
+// memory); in-process cases pass nullptr.
+QJsonObject runCase(const QString &name, int pages, int iterations, const QString &outputPath,
+                    QJsonObject *jobReport, const std::function<bool()> &run)
+{
+    QList<double> latencies;
+    QMap<QString, QList<double>> stageLatencies;
+    bool allSucceeded = true;
+    qint64 toolPeak = 0;
+    
+    resetPeakRss();
+    for (int i = 0; i < iterations; ++i) {
+        QFile::remove(outputPath);
+        StageTracer::instance().clear();
+        if (jobReport) {
+            *jobReport = QJsonObject();
+        }
+        
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = run();
+        latencies << timer.nsecsElapsed() / 1e6;
+        allSucceeded = allSucceeded && ok;
+        if (jobReport) {
+            toolPeak = qMax(toolPeak, toolPeakRssKb(*jobReport));
+        }
+        
+        // Sum the spans of each stage within this iteration
+        QMap<QString, double> iterationStages;
+        for (const QJsonValue &value : StageTracer::instance().events()) {
+            QJsonObject event = value.toObject();
+            if (event["cat"].toString() == "stage") {
+                iterationStages[event["name"].toString()] += event["dur"].toDouble() / 1000.0;
+            }
+        }
+        for (auto it = iterationStages.constBegin(); it != iterationStages.constEnd(); ++it) {
+            stageLatencies[it.key()] << it.value();
+        }
+    }
+    
+    QJsonObject result = latencyStats(latencies);
+    result["case"] = name;
+    result["pages"] = pages;
+    result["iterations"] = iterations;
+    result["success"] = allSucceeded;
+    
+    double median = percentile(latencies, 0.5);
+    result["pages_per_second"] = median > 0.0 ? pages * 1000.0 / median : 0.0;
+    result["output_bytes"] = QFileInfo(outputPath).size();
+    result["peak_rss_kb"] = QJsonObject{
+        {"self", selfPeakRssKb()},
+        {"tools", toolPeak}
+    };
+    
+    QJsonObject stages;
+    for (auto it = stageLatencies.constBegin(); it != stageLatencies.constEnd(); ++it) {
+        stages[it.key()] = latencyStats(it.value());
+    }
+    result["stages"] = stages;
+    
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Launch tools the way the app does
+    SpawnHelper::start();
+    
+    // QPdfWriter needs fonts but no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName("A6BookletBench");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark the A6 booklet pipeline on a synthetic corpus.");
+    parser.addHelpOption();
+    QCommandLineOption pagesOption("pages", "Comma-separated page counts (default 8,64).", "list", "8,64");
+    QCommandLineOption kindsOption("kinds", "Comma-separated corpus kinds: text,images,fonts.", "list", "text,images,fonts");
+    QCommandLineOption imageDpiOption("image-dpi", "Resolution of the images corpus (default 150).", "dpi", "150");
+    QCommandLineOption iterationsOption(QStringList() << "n" << "iterations", "Iterations per case (default 5).", "count", "5");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON report to <file> instead of stdout.", "file");
+    QCommandLineOption corpusOption("corpus-dir", "Keep the generated corpus in <dir>.", "dir");
+    parser.addOption(pagesOption);
+    parser.addOption(kindsOption);
+    parser.addOption(imageDpiOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(outputOption);
+    parser.addOption(corpusOption);
+    parser.process(app);
+    
+    QList<int> pageCounts;
+    for (const QString &value : parser.value(pagesOption).split(',', Qt::SkipEmptyParts)) {
+        pageCounts << value.toInt();
+    }
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    int imageDpi = qMax(36, parser.value(imageDpiOption).toInt());
+    QStringList kinds = parser.value(kindsOption).split(',', Qt::SkipEmptyParts);
+    
+    PathConfig::initialize();
+    
+    QTemporaryDir workDir;
+    QString corpusDir = parser.isSet(corpusOption) ? parser.value(corpusOption) : workDir.filePath("corpus");
+    QDir().mkpath(corpusDir);
+    
+    // Stage spans come from the tracer; the trace file itself is scratch
+    StageTracer::instance().setOutputPath(workDir.filePath("trace.json"));
+    StageTracer::instance().setKeepEvents(true);
+    
+    QJsonArray results;
+    for (CorpusGenerator::Kind kind : CorpusGenerator::allKinds()) {
+        QString kindName = CorpusGenerator::kindName(kind);
+        if (!kinds.contains(kindName)) {
+            continue;
+        }
+        
+        for (int pages : pageCounts) {
+            QString input = QDir(corpusDir).filePath(QString("%1-%2-%3dpi.pdf").arg(kindName).arg(pages).arg(imageDpi));
+            QString error;
+            if (!QFile::exists(input) && !CorpusGenerator::generate(kind, pages, input, error, imageDpi)) {
+                QTextStream(stderr) << error << "\n";
+                return 1;
+            }
+            QTextStream(stderr) << "Benchmarking " << input << "\n";
+            
+            QString output = workDir.filePath("out.pdf");
+            QPDFBookletCreator creator;
+            QJsonObject jobReport;
+            QObject::connect(&creator, &QPDFBookletCreator::processingComplete,
+                             [&](bool, const QString &, const QJsonObject &report) { jobReport = report; });
+            
+            auto addCase = [&](const QString &name, QJsonObject *report, const std::function<bool()> &run) {
+                QJsonObject result = runCase(name, pages, iterations, output, report, run);
+                result["corpus"] = kindName;
+                result["input_bytes"] = QFileInfo(input).size();
+                results.append(result);
+            };
+            
+            addCase("createBooklet", &jobReport, [&]() { return creator.createBooklet(input, output); });
+            addCase("create2UpLayout", &jobReport, [&]() { return creator.create2UpLayout(input, output); });
+            addCase("createSequential2Up", &jobReport, [&]() { return creator.createSequential2Up(input, output); });
+            
+            // Pipeline stages on their own
+            const QList<QPair<QString, QPDFBookletCreator::Stage>> stages = {
+                {"stage:preflight", QPDFBookletCreator::Stage::Preflight},
+                {"stage:padding", QPDFBookletCreator::Stage::Padding},
+                {"stage:reorder", QPDFBookletCreator::Stage::Reorder},
+                {"stage:compile", QPDFBookletCreator::Stage::Compile}
+            };
+            for (const auto &stage : stages) {
+                addCase(stage.first, &jobReport, [&]() { return creator.runStage(stage.second, input, output); });
+            }
+            
+            PdfOptimizer::Options dedup;
+            dedup.deduplicateResources = true;
+            addCase("deduplicateResources", nullptr, [&]() {
+                return PdfOptimizer::optimize(input, output, dedup, error);
+            });
+            
+            PdfOptimizer::Options downsample;
+            downsample.downsampleDpi = 300;
+            addCase("downsample300", nullptr, [&]() {
+                return PdfOptimizer::optimize(input, output, downsample, error);
+            });
+            
+            PdfOptimizer::Options writer;
+            writer.objectStreams = true;
+            writer.parallelCompression = true;
+            addCase("parallelWriter", nullptr, [&]() {
+                return PdfOptimizer::optimize(input, output, writer, error);
+            });
+            
+            // The same passes as a job runs them, on the laid out output
+            PdfOptimizer::Options jobPasses = writer;
+            jobPasses.deduplicateResources = true;
+            jobPasses.downsampleDpi = 300;
+            creator.setOptimizerOptions(jobPasses);
+            addCase("createBooklet+optimize", &jobReport, [&]() { return creator.createBooklet(input, output); });
+            creator.setOptimizerOptions(PdfOptimizer::Options());
+        }
+    }
+    
+    QJsonObject report;
+    report["results"] = results;
+    report["image_dpi"] = imageDpi;
+    report["host"] = QJsonObject{
+        {"cpu_cores", QThread::idealThreadCount()},
+        {"os", QSysInfo::prettyProductName()},
+        {"kernel", QSysInfo::kernelVersion()}
+    };
+    
+    QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            QTextStream(stderr) << "Cannot write report: " << file.fileName() << "\n";
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "corpusgenerator.h"
+#include <QFontDatabase>
+#include <QImage>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QRandomGenerator>
+
+namespace {
+
+const char *LOREM =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud "
+    "exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat. ";
+
+// Deterministic noisy gradient so images do not compress to nothing
+QImage syntheticPhoto(int width, int height, quint32 seed)
+{
+    QRandomGenerator random(seed);
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            int noise = random.bounded(32);
+            line[x] = qRgb((x * 255 / width + noise) & 0xff,
+                           (y * 255 / height + noise) & 0xff,
+                           ((x + y) * 127 / (width + height) + noise) & 0xff);
+        }
+    }
+    return image;
+}
+
+} // namespace
+
+QString CorpusGenerator::kindName(Kind kind)
+{
+    switch (kind) {
+    case TextOnly:
+        return "text";
+    case ImageHeavy:
+        return "images";
+    case ManyFonts:
+        return "fonts";
+    }
+    return QString();
+}
+
+QList<CorpusGenerator::Kind> CorpusGenerator::allKinds()
+{
+    return QList<Kind>() << TextOnly << ImageHeavy << ManyFonts;
+}
+
+bool CorpusGenerator::generate(Kind kind, int pageCount, const QString &path, QString &error,
+                               int imageDpi)
+{
+    QPdfWriter writer(path);
+    writer.setPageSize(QPageSize(QPageSize::A6));
+    writer.setPageMargins(QMarginsF(8, 8, 8, 8), QPageLayout::Millimeter);
+    writer.setResolution(300);
+    writer.setCreator("A6BookletBench");
+    
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        error = "Cannot write corpus file: " + path;
+        return false;
+    }
+    
+    QRect area = painter.viewport();
+    QStringList families = QFontDatabase::families();
+    QImage logo = syntheticPhoto(300, 300, 1);
+    QSize photoSize(qRound(105 / 25.4 * imageDpi), qRound(148 / 25.4 * imageDpi));
+    
+    for (int page = 0; page < pageCount; ++page) {
+        if (page > 0) {
+            writer.newPage();
+        }
+        
+        switch (kind) {
+        case TextOnly: {
+            painter.setFont(QFont("Helvetica", 9));
+            painter.drawText(area, Qt::TextWordWrap,
+                             QString("Page %1\n\n").arg(page + 1) + QString(LOREM).repeated(12));
+            break;
+        }
+        case ImageHeavy: {
+            painter.drawImage(area, syntheticPhoto(photoSize.width(), photoSize.height(), page + 2));
+            painter.drawImage(QRect(area.topLeft(), QSize(area.width() / 4, area.width() / 4)), logo);
+            break;
+        }
+        case ManyFonts: {
+            int lineHeight = area.height() / 12;
+            for (int line = 0; line < 12; ++line) {
+                QString family = families.isEmpty() ? QString("Helvetica")
+                                                    : families.at((page * 12 + line) % families.size());
+                painter.setFont(QFont(family, 8));
+                painter.drawText(QRect(area.left(), area.top() + line * lineHeight, area.width(), lineHeight),
+                                 Qt::TextWordWrap, family + ": " + LOREM);
+            }
+            break;
+        }
+        }
+    }
+    
+    painter.end();
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+
+// Writes synthetic A6 PDFs for the benchmark suite
+class CorpusGenerator
+{
+public:
+    enum Kind {
+        TextOnly,     // paragraphs of body text in one font
+        ImageHeavy,   // a full-bleed photo-like image per page plus a shared logo
+        ManyFonts     // every page set in several different font families
+    };
+    
+    static QString kindName(Kind kind);
+    static QList<Kind> allKinds();
+    
+    // Write a pageCount-page A6 document of the given kind to path. Image
+    // pages carry one full-page image of imageDpi (600 is what designers
+    // typically deliver).
+    static bool generate(Kind kind, int pageCount, const QString &path, QString &error,
+                         int imageDpi = 600);
+};
+
+#endif // CORPUSGENERATOR_H
@@ -0,0 +1,155 @@
+#include "bookletclient.h"
+#include <QDebug>
+#include <QEventLoop>
+#include <QJsonDocument>
+
+BookletClient::BookletClient(const QString &socketName, QObject *parent)
+    : QObject(parent)
+    , m_socketName(socketName)
+    , m_accepted(false)
+    , m_finished(false)
+    , m_succeeded(false)
+    , m_failed(false)
+{
+    connect(&m_socket, &QLocalSocket::readyRead, this, &BookletClient::readMessages);
+}
+
+bool BookletClient::isDaemonRunning(const QString &socketName)
+{
+    QLocalSocket probe;
+    probe.connectToServer(socketName);
+    return probe.waitForConnected(200);
+}
+
+bool BookletClient::submit(const BookletJob &job, QString &error)
+{
+    m_socket.connectToServer(m_socketName);
+    if (!m_socket.waitForConnected(1000)) {
+        error = "Cannot reach the booklet daemon: " + m_socket.errorString();
+        return false;
+    }
+    
+    QJsonObject request;
+    request["type"] = "submit";
+    request["job"] = job.toJson();
+    sendRequest(request);
+    
+    // The reply comes straight back; the job itself may wait in the queue
+    while (!m_accepted && m_message.isEmpty()) {
+        if (!m_socket.waitForReadyRead(5000)) {
+            error = "No answer from the booklet daemon: " + m_socket.errorString();
+            return false;
+        }
+        readMessages();
+    }
+    
+    if (!m_accepted) {
+        error = m_message;
+        return false;
+    }
+    return true;
+}
+
+bool BookletClient::waitForFinished()
+{
+    if (!m_accepted) {
+        return false;
+    }
+    
+    QEventLoop loop;
+    connect(this, &BookletClient::processingComplete, &loop, &QEventLoop::quit);
+    connect(&m_socket, &QLocalSocket::disconnected, &loop, &QEventLoop::quit);
+    if (!m_finished && m_socket.state() == QLocalSocket::ConnectedState) {
+        loop.exec();
+    }
+    
+    if (!m_finished) {
+        m_message = "The booklet daemon went away before job " + m_jobId + " finished";
+    }
+    return m_succeeded;
+}
+
+void BookletClient::submitAsync(const BookletJob &job)
+{
+    m_pendingRequest = QJsonObject();
+    m_pendingRequest["type"] = "submit";
+    m_pendingRequest["job"] = job.toJson();
+    
+    connect(&m_socket, &QLocalSocket::connected, this, [this]() {
+        sendRequest(m_pendingRequest);
+    });
+    connect(&m_socket, &QLocalSocket::errorOccurred, this, [this]() {
+        fail("Cannot reach the booklet daemon: " + m_socket.errorString());
+    });
+    connect(&m_socket, &QLocalSocket::disconnected, this, [this]() {
+        fail("The booklet daemon went away before job " + m_jobId + " finished");
+    });
+    m_socket.connectToServer(m_socketName);
+}
+
+void BookletClient::cancel()
+{
+    if (m_accepted && !m_finished) {
+        QJsonObject request;
+        request["type"] = "cancel";
+        request["id"] = m_jobId;
+        sendRequest(request);
+    }
+}
+
+void BookletClient::sendRequest(const QJsonObject &request)
+{
+    m_socket.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+    m_socket.flush();
+}
+
+void BookletClient::fail(const QString &error)
+{
+    if (m_failed || m_finished) {
+        return;
+    }
+    m_failed = true;
+    m_message = error;
+    emit failed(error);
+}
+
+void BookletClient::readMessages()
+{
+    while (m_socket.canReadLine()) {
+        QJsonDocument document = QJsonDocument::fromJson(m_socket.readLine());
+        if (document.isObject()) {
+            handleMessage(document.object());
+        }
+    }
+}
+
+void BookletClient::handleMessage(const QJsonObject &message)
+{
+    QString type = message["type"].toString();
+    
+    if (type == "accepted") {
+        m_accepted = true;
+        m_jobId = message["id"].toString();
+        qDebug() << "Daemon queued job" << m_jobId << "at position" << message["position"].toInt();
+        emit accepted(m_jobId);
+    } else if (type == "rejected" || type == "error") {
+        if (m_accepted) {
+            // About a later request, such as a cancel that came too late
+            qDebug() << "Daemon:" << message["error"].toString();
+            return;
+        }
+        m_message = message["error"].toString();
+        fail(m_message);
+    } else if (type == "progress") {
+        emit progressChanged(message["percent"].toInt());
+        emit etaChanged(message["remainingMs"].toVariant().toLongLong(), message["stage"].toString());
+    } else if (type == "sheets") {
+        emit sheetsReady(message["first"].toInt(), message["last"].toInt(),
+                         message["count"].toInt(), message["path"].toString());
+    } else if (type == "finished") {
+        m_finished = true;
+        m_succeeded = message["success"].toBool();
+        m_message = message["message"].toString();
+        emit processingComplete(m_succeeded, m_message, message["report"].toObject());
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef BOOKLETCLIENT_H
+#define BOOKLETCLIENT_H
+
+#include "bookletjob.h"
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QObject>
+
+// Submits a job to a running BookletDaemon and relays its progress
+class BookletClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BookletClient(const QString &socketName, QObject *parent = nullptr);
+    
+    // True if a daemon answers on socketName
+    static bool isDaemonRunning(const QString &socketName);
+    
+    // Send the job and wait until the daemon has queued it
+    bool submit(const BookletJob &job, QString &error);
+    
+    // Process events until the submitted job finishes or the daemon goes
+    // away. Returns the job's success.
+    bool waitForFinished();
+    
+    // Connect and send the job without blocking, for callers running an
+    // event loop. accepted() or failed() follows, then progress and
+    // processingComplete, or failed() if the daemon goes away.
+    void submitAsync(const BookletJob &job);
+    
+    // Ask the daemon to drop the submitted job if it has not started yet.
+    // A running job finishes in the daemon.
+    void cancel();
+    
+    QString jobId() const { return m_jobId; }
+    QString message() const { return m_message; }
+
+signals:
+    void progressChanged(int progress);
+    void etaChanged(qint64 remainingMs, const QString &stage);
+    // A streaming job published sheets firstSheet..lastSheet in partPath
+    void sheetsReady(int firstSheet, int lastSheet, int sheetCount, const QString &partPath);
+    void processingComplete(bool success, const QString &message, const QJsonObject &report);
+    void accepted(const QString &jobId);
+    // The job could not be submitted, or the daemon went away before it
+    // finished
+    void failed(const QString &error);
+
+private:
+    void readMessages();
+    void handleMessage(const QJsonObject &message);
+    void sendRequest(const QJsonObject &request);
+    // Emit failed() once, unless the job has already finished
+    void fail(const QString &error);
+    
+    QString m_socketName;
+    QLocalSocket m_socket;
+    QString m_jobId;
+    bool m_accepted;
+    bool m_finished;
+    bool m_succeeded;
+    QString m_message;
+    QJsonObject m_pendingRequest;   // sent once connected
+    bool m_failed;
+};
+
+#endif // BOOKLETCLIENT_H
@@ -0,0 +1,306 @@
+#include "bookletdaemon.h"
+#include "jobjournal.h"
+#include "pdfbookletcreator.h"
+#include "pathconfig.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QUuid>
+
+void DaemonWorker::warmUp()
+{
+    // Resolve every tool once for the life of the daemon
+    PathConfig::initialize();
+    if (!creator()->warmUp()) {
+        qWarning() << "pdflatex not found; layout jobs will fail until it is installed";
+    }
+}
+
+void DaemonWorker::runJob(const QJsonObject &json)
+{
+    BookletJob job = BookletJob::fromJson(json);
+    m_jobId = job.id;
+    m_percent = 0;
+    
+    if (m_journal && m_journal->isCompleted(job.journalKey(), job.outputPath)) {
+        // Same input and options as a finished job whose output is untouched
+        qDebug() << "Daemon skipping job" << job.id << ": already done";
+        emit jobFinished(job.id, true, "Already done: " + job.outputPath, QJsonObject());
+        m_jobId.clear();
+        return;
+    }
+    
+    qDebug() << "Daemon running job" << job.id << job.inputPath;
+    job.run(*creator(), m_journal, "daemon");
+    m_jobId.clear();
+}
+
+QPDFBookletCreator *DaemonWorker::creator()
+{
+    if (m_creator) {
+        return m_creator;
+    }
+    
+    // Created on the worker thread and reused by every job
+    m_creator = new QPDFBookletCreator(this);
+    connect(m_creator, &QPDFBookletCreator::progressChanged, this, [this](int progress) {
+        m_percent = progress;
+    });
+    connect(m_creator, &QPDFBookletCreator::etaChanged, this,
+            [this](qint64 remainingMs, const QString &stage) {
+                emit jobProgress(m_jobId, m_percent, remainingMs, stage);
+            });
+    connect(m_creator, &QPDFBookletCreator::sheetsReady, this,
+            [this](int firstSheet, int lastSheet, int sheetCount, const QString &partPath) {
+                emit jobSheetsReady(m_jobId, firstSheet, lastSheet, sheetCount, partPath);
+            });
+    connect(m_creator, &QPDFBookletCreator::processingComplete, this,
+            [this](bool success, const QString &message, const QJsonObject &report) {
+                emit jobFinished(m_jobId, success, message, report);
+            });
+    return m_creator;
+}
+
+BookletDaemon::BookletDaemon(QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_worker(new DaemonWorker)
+    , m_journal(nullptr)
+    , m_busy(false)
+{
+    m_worker->moveToThread(&m_workerThread);
+    connect(&m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(this, &BookletDaemon::runJob, m_worker, &DaemonWorker::runJob);
+    connect(m_worker, &DaemonWorker::jobProgress, this, &BookletDaemon::jobProgress);
+    connect(m_worker, &DaemonWorker::jobSheetsReady, this, &BookletDaemon::jobSheetsReady);
+    connect(m_worker, &DaemonWorker::jobFinished, this, &BookletDaemon::jobFinished);
+    connect(m_server, &QLocalServer::newConnection, this, &BookletDaemon::acceptConnection);
+    
+    m_workerThread.setObjectName("BookletDaemonWorker");
+    m_workerThread.start();
+    QMetaObject::invokeMethod(m_worker, &DaemonWorker::warmUp, Qt::QueuedConnection);
+}
+
+BookletDaemon::~BookletDaemon()
+{
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+void BookletDaemon::setJournal(JobJournal *journal)
+{
+    m_journal = journal;
+    m_worker->setJournal(journal);
+}
+
+bool BookletDaemon::listen(const QString &socketName, QString &error)
+{
+    // Refuse to take over the socket of a daemon that is still answering
+    QLocalSocket probe;
+    probe.connectToServer(socketName);
+    if (probe.waitForConnected(500)) {
+        error = "A daemon is already listening on " + socketName;
+        return false;
+    }
+    
+    // Left behind by a daemon that did not shut down cleanly
+    QLocalServer::removeServer(socketName);
+    
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(socketName)) {
+        error = "Cannot listen on " + socketName + ": " + m_server->errorString();
+        return false;
+    }
+    
+    qDebug() << "Daemon listening on" << m_server->fullServerName();
+    
+    // Pick up where a crashed daemon left off; nobody is waiting for these
+    if (m_journal) {
+        const QList<QJsonObject> interrupted = m_journal->interruptedJobs("daemon");
+        for (const QJsonObject &json : interrupted) {
+            QueuedJob queued;
+            queued.job = BookletJob::fromJson(json);
+            qDebug() << "Resuming interrupted job" << queued.job.id << queued.job.inputPath;
+            enqueue(queued);
+        }
+        dispatchNext();
+    }
+    return true;
+}
+
+QString BookletDaemon::defaultSocketName()
+{
+    QString user = qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"));
+    return "A6BookletMaker-" + user;
+}
+
+void BookletDaemon::acceptConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QLocalSocket *client = m_server->nextPendingConnection();
+        connect(client, &QLocalSocket::readyRead, this, [this, client]() {
+            readRequests(client);
+        });
+        connect(client, &QLocalSocket::disconnected, client, &QObject::deleteLater);
+    }
+}
+
+void BookletDaemon::readRequests(QLocalSocket *client)
+{
+    while (client->canReadLine()) {
+        QByteArray line = client->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        
+        QJsonParseError parseError;
+        QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+        if (!document.isObject()) {
+            QJsonObject reply;
+            reply["type"] = "error";
+            reply["error"] = "Malformed request: " + parseError.errorString();
+            send(client, reply);
+            continue;
+        }
+        handleRequest(client, document.object());
+    }
+}
+
+void BookletDaemon::handleRequest(QLocalSocket *client, const QJsonObject &request)
+{
+    QString type = request["type"].toString();
+    QJsonObject reply;
+    
+    if (type == "submit") {
+        QueuedJob queued;
+        queued.job = BookletJob::fromJson(request["job"].toObject());
+        queued.client = client;
+        if (queued.job.id.isEmpty()) {
+            queued.job.id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+        }
+        
+        QString error;
+        if (!queued.job.isValid(error)) {
+            reply["type"] = "rejected";
+            reply["error"] = error;
+            send(client, reply);
+            return;
+        }
+        
+        int position = enqueue(queued);
+        reply["type"] = "accepted";
+        reply["id"] = queued.job.id;
+        reply["position"] = position;
+        send(client, reply);
+        dispatchNext();
+    } else if (type == "cancel") {
+        // A running job has no safe point to stop at; only queued ones go
+        QString id = request["id"].toString();
+        for (int i = 0; i < m_queue.size(); ++i) {
+            if (m_queue.at(i).job.id == id) {
+                QueuedJob cancelled = m_queue.takeAt(i);
+                reply["type"] = "finished";
+                reply["id"] = id;
+                reply["success"] = false;
+                reply["message"] = "Cancelled";
+                reply["report"] = QJsonObject();
+                send(cancelled.client, reply);
+                return;
+            }
+        }
+        reply["type"] = "error";
+        reply["error"] = "Job " + id + " is not queued";
+        send(client, reply);
+    } else if (type == "status") {
+        QJsonArray queuedIds;
+        for (const QueuedJob &queued : m_queue) {
+            queuedIds.append(queued.job.id);
+        }
+        reply["type"] = "status";
+        reply["running"] = m_busy ? QJsonValue(m_running.job.id) : QJsonValue();
+        reply["queued"] = queuedIds;
+        send(client, reply);
+    } else {
+        reply["type"] = "error";
+        reply["error"] = "Unknown request type: " + type;
+        send(client, reply);
+    }
+}
+
+int BookletDaemon::enqueue(const QueuedJob &queued)
+{
+    // Behind every job of the same or higher priority
+    int index = 0;
+    while (index < m_queue.size() && m_queue.at(index).job.priority >= queued.job.priority) {
+        ++index;
+    }
+    m_queue.insert(index, queued);
+    
+    // Position counted from the job now running
+    return index + (m_busy ? 1 : 0);
+}
+
+void BookletDaemon::dispatchNext()
+{
+    if (m_busy || m_queue.isEmpty()) {
+        return;
+    }
+    m_running = m_queue.takeFirst();
+    m_busy = true;
+    emit runJob(m_running.job.toJson());
+}
+
+void BookletDaemon::jobProgress(const QString &id, int percent, qint64 remainingMs, const QString &stage)
+{
+    QJsonObject message;
+    message["type"] = "progress";
+    message["id"] = id;
+    message["percent"] = percent;
+    message["remainingMs"] = remainingMs;
+    message["stage"] = stage;
+    send(m_running.client, message);
+}
+
+void BookletDaemon::jobSheetsReady(const QString &id, int firstSheet, int lastSheet,
+                                   int sheetCount, const QString &partPath)
+{
+    QJsonObject message;
+    message["type"] = "sheets";
+    message["id"] = id;
+    message["first"] = firstSheet;
+    message["last"] = lastSheet;
+    message["count"] = sheetCount;
+    message["path"] = partPath;
+    send(m_running.client, message);
+}
+
+void BookletDaemon::jobFinished(const QString &id, bool success, const QString &message,
+                                const QJsonObject &report)
+{
+    qDebug() << "Daemon finished job" << id << (success ? "successfully" : "with an error:") << message;
+    
+    QJsonObject reply;
+    reply["type"] = "finished";
+    reply["id"] = id;
+    reply["success"] = success;
+    reply["message"] = message;
+    reply["report"] = report;
+    send(m_running.client, reply);
+    
+    m_busy = false;
+    m_running = QueuedJob();
+    dispatchNext();
+}
+
+void BookletDaemon::send(QLocalSocket *client, const QJsonObject &message)
+{
+    // The client may have gone away; the job still runs to completion
+    if (!client || client->state() != QLocalSocket::ConnectedState) {
+        return;
+    }
+    client->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n');
+    client->flush();
+}
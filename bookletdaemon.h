@@ -0,0 +1,113 @@
+#ifndef BOOKLETDAEMON_H
+#define BOOKLETDAEMON_H
+
+#include "bookletjob.h"
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QThread>
+
+class JobJournal;
+class QLocalServer;
+class QLocalSocket;
+class QPDFBookletCreator;
+
+// Runs jobs for the daemon on its own thread, with one creator kept for the
+// life of the daemon so resolved tools and caches carry over between jobs
+class DaemonWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Set before the first job is queued
+    void setJournal(JobJournal *journal) { m_journal = journal; }
+
+public slots:
+    void warmUp();
+    void runJob(const QJsonObject &job);
+
+signals:
+    void jobProgress(const QString &id, int percent, qint64 remainingMs, const QString &stage);
+    void jobSheetsReady(const QString &id, int firstSheet, int lastSheet, int sheetCount,
+                        const QString &partPath);
+    void jobFinished(const QString &id, bool success, const QString &message, const QJsonObject &report);
+
+private:
+    QPDFBookletCreator *creator();
+    
+    QPDFBookletCreator *m_creator = nullptr;
+    JobJournal *m_journal = nullptr;
+    QString m_jobId;
+    int m_percent = 0;
+};
+
+// Headless print server. Clients connect to a QLocalServer socket and send
+// newline-delimited JSON requests:
+//
+//   {"type": "submit", "job": {...}}   -> {"type": "accepted", "id", "position"}
+//                                         or {"type": "rejected", "error"}
+//   {"type": "status"}                 -> {"type": "status", "running", "queued"}
+//   {"type": "cancel", "id"}           -> {"type": "finished", ...} if the job
+//                                         was still queued, else an error
+//
+// The submitting connection then receives {"type": "progress", ...}, for
+// streaming jobs {"type": "sheets", "id", "first", "last", "count", "path"}
+// as each part of the output is published, and finally
+// {"type": "finished", "id", "success", "message", "report"}.
+// Jobs run one at a time, highest priority first, FIFO within a priority.
+// With a journal, jobs already done are answered without running them and
+// jobs a previous daemon was running when it died are queued again.
+class BookletDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BookletDaemon(QObject *parent = nullptr);
+    ~BookletDaemon();
+    
+    // Record jobs in journal, which must outlive the daemon. Call before
+    // listen.
+    void setJournal(JobJournal *journal);
+    
+    bool listen(const QString &socketName, QString &error);
+    
+    // Per-user socket name, so users on a shared workstation get their own
+    // daemon
+    static QString defaultSocketName();
+
+signals:
+    // Queued for the worker thread
+    void runJob(const QJsonObject &job);
+
+private slots:
+    void acceptConnection();
+    void jobProgress(const QString &id, int percent, qint64 remainingMs, const QString &stage);
+    void jobSheetsReady(const QString &id, int firstSheet, int lastSheet, int sheetCount,
+                        const QString &partPath);
+    void jobFinished(const QString &id, bool success, const QString &message, const QJsonObject &report);
+
+private:
+    struct QueuedJob
+    {
+        BookletJob job;
+        QPointer<QLocalSocket> client;
+    };
+    
+    void readRequests(QLocalSocket *client);
+    void handleRequest(QLocalSocket *client, const QJsonObject &request);
+    int enqueue(const QueuedJob &queued);
+    void dispatchNext();
+    static void send(QLocalSocket *client, const QJsonObject &message);
+    
+    QLocalServer *m_server;
+    QThread m_workerThread;
+    DaemonWorker *m_worker;
+    JobJournal *m_journal;
+    
+    QList<QueuedJob> m_queue;
+    bool m_busy;
+    QueuedJob m_running;
+};
+
+#endif // BOOKLETDAEMON_H
@@ -0,0 +1,137 @@
+#include "bookletjob.h"
+#include "jobjournal.h"
+#include "pdfbookletcreator.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QJsonDocument>
+
+namespace {
+
+QJsonObject optimizerToJson(const PdfOptimizer::Options &options)
+{
+    QJsonObject json;
+    json["deduplicateResources"] = options.deduplicateResources;
+    json["downsampleDpi"] = options.downsampleDpi;
+    json["objectStreams"] = options.objectStreams;
+    json["compressionLevel"] = options.compressionLevel;
+    json["parallelCompression"] = options.parallelCompression;
+    json["linearize"] = options.linearize;
+    return json;
+}
+
+PdfOptimizer::Options optimizerFromJson(const QJsonObject &json)
+{
+    PdfOptimizer::Options options;
+    options.deduplicateResources = json["deduplicateResources"].toBool(false);
+    options.downsampleDpi = qMax(0, json["downsampleDpi"].toInt(0));
+    options.objectStreams = json["objectStreams"].toBool(false);
+    options.compressionLevel = qBound(-1, json["compressionLevel"].toInt(-1), 9);
+    options.parallelCompression = json["parallelCompression"].toBool(false);
+    options.linearize = json["linearize"].toBool(false);
+    return options;
+}
+
+} // namespace
+
+QJsonObject BookletJob::toJson() const
+{
+    QJsonObject json;
+    json["id"] = id;
+    json["input"] = inputPath;
+    json["output"] = outputPath;
+    json["layout"] = layout;
+    json["startFromBeginning"] = startFromBeginning;
+    json["streaming"] = streaming;
+    json["reproducible"] = reproducible;
+    json["priority"] = priority;
+    json["optimizer"] = optimizerToJson(optimizer);
+    return json;
+}
+
+BookletJob BookletJob::fromJson(const QJsonObject &json)
+{
+    BookletJob job;
+    job.id = json["id"].toString();
+    job.inputPath = json["input"].toString();
+    job.outputPath = json["output"].toString();
+    job.layout = json["layout"].toString("booklet");
+    job.startFromBeginning = json["startFromBeginning"].toBool(true);
+    job.streaming = json["streaming"].toBool(false);
+    job.reproducible = json["reproducible"].toBool(false);
+    job.priority = json["priority"].toInt(0);
+    job.optimizer = optimizerFromJson(json["optimizer"].toObject());
+    return job;
+}
+
+bool BookletJob::isValid(QString &error) const
+{
+    if (inputPath.isEmpty() || outputPath.isEmpty()) {
+        error = "A job needs an input and an output path";
+        return false;
+    }
+    if (QFileInfo(inputPath).isRelative() || QFileInfo(outputPath).isRelative()) {
+        // The daemon runs in its own working directory
+        error = "Job paths must be absolute";
+        return false;
+    }
+    if (layout != "booklet" && layout != "2up" && layout != "sequential") {
+        error = "Unknown layout: " + layout;
+        return false;
+    }
+    return true;
+}
+
+QString BookletJob::journalKey() const
+{
+    QFileInfo input(inputPath);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QString("%1\n%2\n%3;%4;%5;%6\n%7;%8")
+                 .arg(input.absoluteFilePath(), QFileInfo(outputPath).absoluteFilePath(), layout)
+                 .arg(startFromBeginning)
+                 .arg(streaming)
+                 .arg(reproducible)
+                 .arg(input.size())
+                 .arg(input.lastModified().toMSecsSinceEpoch()).toUtf8());
+    if (optimizer.isEnabled()) {
+        // Jobs without passes keep the keys they had before passes existed
+        hash.addData(QJsonDocument(optimizerToJson(optimizer)).toJson(QJsonDocument::Compact));
+    }
+    return hash.result().left(12).toHex();
+}
+
+bool BookletJob::run(QPDFBookletCreator &creator, JobJournal *journal, const QString &origin) const
+{
+    creator.setStreamingOutput(streaming);
+    creator.setReproducible(reproducible);
+    creator.setOptimizerOptions(optimizer);
+    
+    QString key;
+    QString message;
+    QMetaObject::Connection resultConnection;
+    if (journal) {
+        key = journalKey();
+        journal->recordStart(key, *this, origin);
+        creator.setJournal(journal, key);
+        resultConnection = QObject::connect(&creator, &QPDFBookletCreator::processingComplete,
+                                            [&message](bool, const QString &text) {
+                                                message = text;
+                                            });
+    }
+    
+    bool success;
+    if (layout == "2up") {
+        success = creator.create2UpLayout(inputPath, outputPath);
+    } else if (layout == "sequential") {
+        success = creator.createSequential2Up(inputPath, outputPath);
+    } else {
+        success = creator.createBooklet(inputPath, outputPath, startFromBeginning);
+    }
+    
+    if (journal) {
+        QObject::disconnect(resultConnection);
+        creator.setJournal(nullptr, QString());
+        journal->recordFinish(key, success, outputPath, message);
+    }
+    return success;
+}
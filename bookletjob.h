@@ -0,0 +1,47 @@
+#ifndef BOOKLETJOB_H
+#define BOOKLETJOB_H
+
+#include "pdfoptimizer.h"
+#include <QJsonObject>
+#include <QString>
+
+class JobJournal;
+class QPDFBookletCreator;
+
+// One layout job as passed between the CLI, the GUI and the daemon
+struct BookletJob
+{
+    QString id;
+    QString inputPath;
+    QString outputPath;
+    QString layout = "booklet";         // booklet, 2up or sequential
+    bool startFromBeginning = true;
+    bool streaming = false;
+    bool reproducible = false;
+    int priority = 0;                   // higher runs first
+    
+    // Optional in-process passes. Only the user-facing settings travel with
+    // the job; the creator fills in placementSlot and the reproducible
+    // fields itself.
+    PdfOptimizer::Options optimizer;
+    
+    QJsonObject toJson() const;
+    static BookletJob fromJson(const QJsonObject &json);
+    
+    // Check the fields a job cannot run without
+    bool isValid(QString &error) const;
+    
+    // Identifies the job across restarts: a hash of the paths, the options
+    // and the input's size and modification time, so an edited input is a
+    // new job
+    QString journalKey() const;
+    
+    // Apply the job's options to creator and run it there. The result is
+    // reported through the creator's processingComplete signal. With a
+    // journal, the attempt is recorded under origin and stages completed by
+    // an earlier attempt are reused.
+    bool run(QPDFBookletCreator &creator, JobJournal *journal = nullptr,
+             const QString &origin = QString()) const;
+};
+
+#endif // BOOKLETJOB_H
@@ -0,0 +1,176 @@
+#include "bookletengine.h"
+#include "../pathconfig.h"
+#include "../pdfbookletcreator.h"
+#include "../spawnhelper.h"
+#include <QBuffer>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <mutex>
+
+namespace {
+
+// Bumped in the minor number for additions, in the major one for breaks
+const char *const ENGINE_VERSION = "1.1";
+
+// PathConfig's statics are not safe to fill from several threads at once
+std::once_flag toolsResolved;
+
+} // namespace
+
+class BookletRequest::Data : public QSharedData
+{
+public:
+    QByteArray input;
+    Layout layout = Booklet;
+    bool startFromBeginning = true;
+    bool reproducible = false;
+    PdfOptimizer::Options optimizer;
+};
+
+BookletRequest::BookletRequest()
+    : d(new Data)
+{
+}
+
+BookletRequest::BookletRequest(const QByteArray &pdf, Layout layout)
+    : d(new Data)
+{
+    d->input = pdf;
+    d->layout = layout;
+}
+
+BookletRequest::BookletRequest(const BookletRequest &other) = default;
+BookletRequest &BookletRequest::operator=(const BookletRequest &other) = default;
+BookletRequest::~BookletRequest() = default;
+
+QByteArray BookletRequest::input() const { return d->input; }
+void BookletRequest::setInput(const QByteArray &pdf) { d->input = pdf; }
+BookletRequest::Layout BookletRequest::layout() const { return d->layout; }
+void BookletRequest::setLayout(Layout layout) { d->layout = layout; }
+bool BookletRequest::startFromBeginning() const { return d->startFromBeginning; }
+void BookletRequest::setStartFromBeginning(bool start) { d->startFromBeginning = start; }
+bool BookletRequest::reproducible() const { return d->reproducible; }
+void BookletRequest::setReproducible(bool reproducible) { d->reproducible = reproducible; }
+bool BookletRequest::deduplicateResources() const { return d->optimizer.deduplicateResources; }
+void BookletRequest::setDeduplicateResources(bool deduplicate) { d->optimizer.deduplicateResources = deduplicate; }
+int BookletRequest::downsampleDpi() const { return d->optimizer.downsampleDpi; }
+void BookletRequest::setDownsampleDpi(int dpi) { d->optimizer.downsampleDpi = qMax(0, dpi); }
+bool BookletRequest::objectStreams() const { return d->optimizer.objectStreams; }
+void BookletRequest::setObjectStreams(bool enabled) { d->optimizer.objectStreams = enabled; }
+int BookletRequest::compressionLevel() const { return d->optimizer.compressionLevel; }
+void BookletRequest::setCompressionLevel(int level) { d->optimizer.compressionLevel = qBound(-1, level, 9); }
+bool BookletRequest::parallelCompression() const { return d->optimizer.parallelCompression; }
+void BookletRequest::setParallelCompression(bool enabled) { d->optimizer.parallelCompression = enabled; }
+bool BookletRequest::linearize() const { return d->optimizer.linearize; }
+void BookletRequest::setLinearize(bool enabled) { d->optimizer.linearize = enabled; }
+
+class BookletResult::Data : public QSharedData
+{
+public:
+    bool success = false;
+    QString message;
+    QByteArray output;
+    QJsonObject report;
+};
+
+BookletResult::BookletResult()
+    : d(new Data)
+{
+}
+
+BookletResult::BookletResult(const BookletResult &other) = default;
+BookletResult &BookletResult::operator=(const BookletResult &other) = default;
+BookletResult::~BookletResult() = default;
+
+bool BookletResult::isSuccess() const { return d->success; }
+QString BookletResult::message() const { return d->message; }
+QByteArray BookletResult::output() const { return d->output; }
+QJsonObject BookletResult::report() const { return d->report; }
+
+class BookletEngine::Private
+{
+public:
+    QThreadPool pool;
+    // Resolved once here rather than by every creator
+    QString pdflatexPath;
+};
+
+BookletEngine::BookletEngine(int maxConcurrentJobs)
+    : d(new Private)
+{
+    d->pool.setMaxThreadCount(maxConcurrentJobs > 0 ? maxConcurrentJobs : QThread::idealThreadCount());
+    d->pool.setObjectName("BookletEnginePool");
+    std::call_once(toolsResolved, []() { PathConfig::initialize(); });
+    d->pdflatexPath = PathConfig::pdflatexPath;
+}
+
+BookletEngine::~BookletEngine()
+{
+    waitForDone();
+}
+
+BookletResult BookletEngine::run(const BookletRequest &request)
+{
+    BookletResult result;
+    
+    QPDFBookletCreator creator;
+    creator.setPdflatexPath(d->pdflatexPath);
+    creator.setReproducible(request.reproducible());
+    PdfOptimizer::Options optimizer;
+    optimizer.deduplicateResources = request.deduplicateResources();
+    optimizer.downsampleDpi = request.downsampleDpi();
+    optimizer.objectStreams = request.objectStreams();
+    optimizer.compressionLevel = request.compressionLevel();
+    optimizer.parallelCompression = request.parallelCompression();
+    optimizer.linearize = request.linearize();
+    creator.setOptimizerOptions(optimizer);
+    QObject::connect(&creator, &QPDFBookletCreator::processingComplete,
+                     [&result](bool, const QString &message, const QJsonObject &report) {
+                         result.d->message = message;
+                         result.d->report = report;
+                     });
+    
+    // The creator streams the result straight into the result's buffer
+    QBuffer output(&result.d->output);
+    output.open(QIODevice::WriteOnly);
+    switch (request.layout()) {
+    case BookletRequest::TwoUp:
+        result.d->success = creator.create2UpLayout(request.input(), &output);
+        break;
+    case BookletRequest::Sequential:
+        result.d->success = creator.createSequential2Up(request.input(), &output);
+        break;
+    default:
+        result.d->success = creator.createBooklet(request.input(), &output, request.startFromBeginning());
+        break;
+    }
+    output.close();
+    
+    if (!result.d->success) {
+        result.d->output.clear();
+    }
+    return result;
+}
+
+QFuture<BookletResult> BookletEngine::submit(const BookletRequest &request)
+{
+    return QtConcurrent::run(&d->pool, [this, request]() {
+        return run(request);
+    });
+}
+
+void BookletEngine::waitForDone()
+{
+    d->pool.waitForDone();
+}
+
+QString BookletEngine::version()
+{
+    return ENGINE_VERSION;
+}
+
+void BookletEngine::startSpawnHelper()
+{
+    SpawnHelper::start();
+}
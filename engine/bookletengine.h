@@ -0,0 +1,141 @@
+#ifndef BOOKLETENGINE_H
+#define BOOKLETENGINE_H
+
+#include <QByteArray>
+#include <QFuture>
+#include <QJsonObject>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QtGlobal>
+#include <memory>
+
+#if defined(BOOKLETENGINE_LIBRARY)
+#define BOOKLETENGINE_EXPORT Q_DECL_EXPORT
+#else
+#define BOOKLETENGINE_EXPORT Q_DECL_IMPORT
+#endif
+
+// Public interface of libbookletengine: the layout pipeline without the
+// GUI, so other services can embed it.
+//
+// Every class keeps its state behind a private pointer, so fields can be
+// added without breaking binary compatibility. Nothing from the app's own
+// headers shows through. The library needs QtCore and QtGui but not
+// QtWidgets. The host must create a QCoreApplication before the first job,
+// because QSettings, image plugins and the tool lookup rely on one.
+
+// Input and options of one job
+class BOOKLETENGINE_EXPORT BookletRequest
+{
+public:
+    enum Layout {
+        Booklet,        // A6 booklet on A4 sheets
+        TwoUp,          // booklet page order, two pages per side
+        Sequential      // two pages per side in reading order
+    };
+    
+    BookletRequest();
+    explicit BookletRequest(const QByteArray &pdf, Layout layout = Booklet);
+    BookletRequest(const BookletRequest &other);
+    BookletRequest &operator=(const BookletRequest &other);
+    ~BookletRequest();
+    
+    // The input document, as PDF bytes
+    QByteArray input() const;
+    void setInput(const QByteArray &pdf);
+    
+    Layout layout() const;
+    void setLayout(Layout layout);
+    
+    // Booklet only: start the page order from the first page (default) or
+    // from the back
+    bool startFromBeginning() const;
+    void setStartFromBeginning(bool start);
+    
+    // Byte-identical output for identical input
+    bool reproducible() const;
+    void setReproducible(bool reproducible);
+    
+    // Optional passes over the output, all off by default.
+    // Merge identical images, fonts and ICC profiles across pages
+    bool deduplicateResources() const;
+    void setDeduplicateResources(bool deduplicate);
+    // Downsample images printed above dpi (0 = off)
+    int downsampleDpi() const;
+    void setDownsampleDpi(int dpi);
+    // Pack objects into object streams
+    bool objectStreams() const;
+    void setObjectStreams(bool enabled);
+    // zlib level 1-9 for rewritten streams, -1 for zlib's default
+    int compressionLevel() const;
+    void setCompressionLevel(int level);
+    // Deflate streams on all cores
+    bool parallelCompression() const;
+    void setParallelCompression(bool enabled);
+    // Fast first-page display
+    bool linearize() const;
+    void setLinearize(bool enabled);
+
+private:
+    class Data;
+    QSharedDataPointer<Data> d;
+};
+
+// Outcome of one job
+class BOOKLETENGINE_EXPORT BookletResult
+{
+public:
+    BookletResult();
+    BookletResult(const BookletResult &other);
+    BookletResult &operator=(const BookletResult &other);
+    ~BookletResult();
+    
+    bool isSuccess() const;
+    // What went wrong, or a summary of the finished job
+    QString message() const;
+    // The laid out PDF; empty if the job failed
+    QByteArray output() const;
+    // Resource report of the job, as written to job-reports.jsonl
+    QJsonObject report() const;
+
+private:
+    friend class BookletEngine;
+    class Data;
+    QSharedDataPointer<Data> d;
+};
+
+// Runs jobs, synchronously on the calling thread or asynchronously on the
+// engine's own pool. One engine can be shared by any number of threads.
+class BOOKLETENGINE_EXPORT BookletEngine
+{
+public:
+    // maxConcurrentJobs bounds the jobs submit() runs at once; 0 means one
+    // per core. Child tools are limited across all jobs by the process
+    // governor either way.
+    explicit BookletEngine(int maxConcurrentJobs = 0);
+    ~BookletEngine();
+    BookletEngine(const BookletEngine &) = delete;
+    BookletEngine &operator=(const BookletEngine &) = delete;
+    
+    // Run a job on the calling thread and return its result
+    BookletResult run(const BookletRequest &request);
+    
+    // Queue a job; the future finishes with its result
+    QFuture<BookletResult> submit(const BookletRequest &request);
+    
+    // Wait for every submitted job to finish
+    void waitForDone();
+    
+    // Version of this library's interface, "major.minor"
+    static QString version();
+    
+    // Fork the helper that launches the tool children (see SpawnHelper).
+    // Optional; call at the top of main(), before any thread exists.
+    static void startSpawnHelper();
+
+private:
+    class Private;
+    std::unique_ptr<Private> d;
+};
+
+#endif // BOOKLETENGINE_H
@@ -0,0 +1,34 @@
+# bookletengine.pro - the layout pipeline as a library, without the GUI
+#
+# For services that embed the engine instead of running the app; the
+# public interface is bookletengine.h.
+#
+#   (cd core && qmake bookletcore.pro && make)
+#   qmake bookletengine.pro && make
+
+QT       += core gui concurrent
+QT       -= widgets
+TEMPLATE = lib
+TARGET   = bookletengine
+VERSION  = 1.1.0
+
+DEFINES += BOOKLETENGINE_LIBRARY
+DEFINES += QT_DEPRECATED_WARNINGS
+CONFIG += sdk_no_version_check
+
+# The pipeline itself; only the facade is compiled here
+include(core/bookletcore.pri)
+
+SOURCES += \
+    bookletengine.cpp
+
+HEADERS += \
+    bookletengine.h
+
+# Only the public header is installed
+headers.files = bookletengine.h
+unix {
+    target.path = /usr/local/lib
+    headers.path = /usr/local/include/bookletengine
+    INSTALLS += target headers
+}
@@ -0,0 +1,19 @@
+# bookletcore.pri - link the static pipeline library built by bookletcore.pro
+#
+# Build engine/core first; the Makefile's core target does.
+
+QT += gui concurrent
+
+INCLUDEPATH += $$PWD/../..
+LIBS += -L$$PWD -lbookletcore
+PRE_TARGETDEPS += $$PWD/libbookletcore.a
+
+# What the library itself links against
+macx {
+    LIBS += -L/opt/homebrew/lib -lqpdf
+}
+
+unix:!macx {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libqpdf
+}
@@ -0,0 +1,64 @@
+# bookletcore.pro - the layout pipeline as an internal static library
+#
+# Built once and linked by the app, the benchmark and libbookletengine, so
+# the pipeline has a single source list. Its headers are not public; other
+# projects link libbookletengine instead. Consumers include bookletcore.pri.
+#
+#   qmake bookletcore.pro && make
+
+QT       += core gui concurrent
+QT       -= widgets
+TEMPLATE = lib
+CONFIG  += staticlib
+TARGET   = bookletcore
+
+DEFINES += QT_DEPRECATED_WARNINGS
+CONFIG += sdk_no_version_check
+
+macx {
+    INCLUDEPATH += /opt/homebrew/Cellar/qpdf/12.1.0/include
+}
+
+unix:!macx {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libqpdf
+}
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../bookletjob.cpp \
+    ../../jobjournal.cpp \
+    ../../outputring.cpp \
+    ../../pathconfig.cpp \
+    ../../pdfbookletcreator.cpp \
+    ../../pdfoptimizer.cpp \
+    ../../processgovernor.cpp \
+    ../../progressestimator.cpp \
+    ../../rendererloader.cpp \
+    ../../resourcereport.cpp \
+    ../../scratchdir.cpp \
+    ../../spawnhelper.cpp \
+    ../../stagetracer.cpp \
+    ../../stagewatchdog.cpp \
+    ../../taskscheduler.cpp \
+    ../../toolprocess.cpp
+
+HEADERS += \
+    ../../bookletjob.h \
+    ../../jobjournal.h \
+    ../../outputring.h \
+    ../../pathconfig.h \
+    ../../pdfbookletcreator.h \
+    ../../pdfoptimizer.h \
+    ../../pdfrenderer.h \
+    ../../processgovernor.h \
+    ../../progressestimator.h \
+    ../../rendererloader.h \
+    ../../resourcereport.h \
+    ../../scratchdir.h \
+    ../../spawnhelper.h \
+    ../../stagetracer.h \
+    ../../stagewatchdog.h \
+    ../../taskscheduler.h \
+    ../../toolprocess.h
@@ -0,0 +1,206 @@
+#include "hotfolder.h"
+#include "pdfbookletcreator.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+namespace {
+
+// A steady trickle of arrivals must not hold a batch back forever
+const int MAX_SETTLE_PERIODS = 5;
+
+} // namespace
+
+HotFolder::HotFolder(const QString &watchPath, const BookletJob &job, int workers,
+                     JobJournal *journal, QObject *parent)
+    : QObject(parent)
+    , m_watchDir(QDir(watchPath).absolutePath())
+    , m_job(job)
+    , m_journal(journal)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_batches(0)
+{
+    QString parentPath = QFileInfo(m_watchDir.path()).absolutePath();
+    QString name = m_watchDir.dirName();
+    m_doneDir = QDir(parentPath).filePath(name + "-done");
+    m_failedDir = QDir(parentPath).filePath(name + "-failed");
+    
+    m_pool.setMaxThreadCount(qMax(1, workers));
+    m_pool.setObjectName("HotFolderPool");
+    
+    m_settleTimer.setSingleShot(true);
+    connect(&m_settleTimer, &QTimer::timeout, this, &HotFolder::dispatchSettled);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &HotFolder::folderChanged);
+}
+
+bool HotFolder::start(QString &error)
+{
+    if (!m_watchDir.exists()) {
+        error = "Watch folder does not exist: " + m_watchDir.path();
+        return false;
+    }
+    if (!QDir().mkpath(m_doneDir.path()) || !QDir().mkpath(m_failedDir.path())) {
+        error = "Cannot create " + m_doneDir.path() + " or " + m_failedDir.path();
+        return false;
+    }
+    if (!m_watcher->addPath(m_watchDir.path())) {
+        error = "Cannot watch " + m_watchDir.path();
+        return false;
+    }
+    
+    qDebug() << "Watching" << m_watchDir.path() << "with" << m_pool.maxThreadCount() << "worker(s)";
+    folderChanged();
+    return true;
+}
+
+int HotFolder::settleMs()
+{
+    bool ok;
+    int ms = qEnvironmentVariableIntValue("BOOKLET_HOTFOLDER_SETTLE_MS", &ok);
+    return ok && ms > 0 ? ms : 2000;
+}
+
+void HotFolder::folderChanged()
+{
+    const QFileInfoList entries = m_watchDir.entryInfoList(QStringList() << "*.pdf" << "*.PDF",
+                                                           QDir::Files | QDir::NoDotAndDotDot);
+    for (const QFileInfo &entry : entries) {
+        QString fileName = entry.fileName();
+        if (m_inFlight.contains(fileName) || m_candidates.contains(fileName)) {
+            continue;
+        }
+        // Settled once a later look finds the same size and time
+        Candidate candidate;
+        candidate.size = entry.size();
+        candidate.modified = entry.lastModified();
+        m_candidates.insert(fileName, candidate);
+    }
+    
+    if (m_candidates.isEmpty()) {
+        return;
+    }
+    
+    // Debounce: every change pushes the batch back, up to a limit
+    if (!m_waiting.isValid()) {
+        m_waiting.start();
+    }
+    if (m_waiting.elapsed() < MAX_SETTLE_PERIODS * settleMs() || !m_settleTimer.isActive()) {
+        m_settleTimer.start(settleMs());
+    }
+}
+
+void HotFolder::dispatchSettled()
+{
+    QStringList settled;
+    for (auto it = m_candidates.begin(); it != m_candidates.end();) {
+        QFileInfo info(m_watchDir.filePath(it.key()));
+        if (!info.exists()) {
+            it = m_candidates.erase(it);
+            continue;
+        }
+        if (info.size() > 0 && info.size() == it->size && info.lastModified() == it->modified) {
+            settled << it.key();
+            it = m_candidates.erase(it);
+            continue;
+        }
+        // Still being written; look again next period
+        it->size = info.size();
+        it->modified = info.lastModified();
+        ++it;
+    }
+    
+    if (m_candidates.isEmpty()) {
+        m_waiting.invalidate();
+    } else {
+        m_waiting.start();
+        m_settleTimer.start(settleMs());
+    }
+    
+    if (settled.isEmpty()) {
+        return;
+    }
+    
+    settled.sort();
+    ++m_batches;
+    qDebug() << "Hot folder batch" << m_batches << ":" << settled;
+    emit batchStarted(m_batches, settled.size());
+    
+    for (const QString &fileName : std::as_const(settled)) {
+        m_inFlight.insert(fileName);
+        QString inputPath = m_watchDir.filePath(fileName);
+        // Written under a hidden name and renamed when complete
+        QString partialOutput = m_doneDir.filePath(
+            "." + QFileInfo(fileName).completeBaseName() + "-booklet.pdf.part");
+        
+        auto *watcher = new QFutureWatcher<Result>(this);
+        connect(watcher, &QFutureWatcher<Result>::finished, this, [this, watcher]() {
+            finishFile(watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(&m_pool, [this, inputPath, partialOutput]() {
+            return process(inputPath, partialOutput);
+        }));
+    }
+}
+
+HotFolder::Result HotFolder::process(const QString &inputPath, const QString &partialOutput) const
+{
+    BookletJob job = m_job;
+    job.inputPath = inputPath;
+    job.outputPath = partialOutput;
+    
+    Result result;
+    result.inputPath = inputPath;
+    result.partialOutput = partialOutput;
+    
+    QPDFBookletCreator creator;
+    QObject::connect(&creator, &QPDFBookletCreator::processingComplete,
+                     [&result](bool, const QString &message) {
+                         result.message = message;
+                     });
+    result.success = job.run(creator, m_journal, "hotfolder");
+    return result;
+}
+
+void HotFolder::finishFile(const Result &result)
+{
+    QFileInfo input(result.inputPath);
+    QString fileName = input.fileName();
+    QString baseName = input.completeBaseName();
+    bool success = result.success;
+    QString message = result.message;
+    
+    if (success) {
+        if (!moveInto(result.partialOutput, m_doneDir, baseName + "-booklet.pdf")) {
+            success = false;
+            message = "Cannot move the booklet into " + m_doneDir.path();
+        } else {
+            moveInto(result.inputPath, m_doneDir, fileName);
+        }
+    }
+    
+    if (!success) {
+        QFile::remove(result.partialOutput);
+        moveInto(result.inputPath, m_failedDir, fileName);
+        QFile log(m_failedDir.filePath(baseName + ".log"));
+        if (log.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            log.write(message.toUtf8() + "\n");
+        }
+    }
+    
+    m_inFlight.remove(fileName);
+    qDebug() << "Hot folder:" << fileName << (success ? "done" : "failed:") << (success ? QString() : message);
+    emit fileFinished(fileName, success, message);
+}
+
+bool HotFolder::moveInto(const QString &path, const QDir &dir, const QString &fileName)
+{
+    QString target = dir.filePath(fileName);
+    if (QFile::exists(target)) {
+        QFile::remove(target);
+    }
+    return QFile::rename(path, target);
+}
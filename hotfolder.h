@@ -0,0 +1,87 @@
+#ifndef HOTFOLDER_H
+#define HOTFOLDER_H
+
+#include "bookletjob.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+
+class JobJournal;
+class QFileSystemWatcher;
+
+// Watch folder for prepress drops. PDFs copied into the folder are picked
+// up once they have stopped growing, grouped with whatever else arrived in
+// the same quiet period and laid out on a bounded pool of workers.
+//
+// For a folder "inbox", results go to the sibling folders "inbox-done"
+// (the booklet as "<name>-booklet.pdf" plus the original) and
+// "inbox-failed" (the original plus "<name>.log" with the error).
+class HotFolder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Every file is laid out with the layout and options of job; its paths
+    // are filled in per file
+    HotFolder(const QString &watchPath, const BookletJob &job, int workers,
+              JobJournal *journal = nullptr, QObject *parent = nullptr);
+    
+    // Start watching; PDFs already in the folder count as new arrivals
+    bool start(QString &error);
+    
+    QString donePath() const { return m_doneDir.path(); }
+    QString failedPath() const { return m_failedDir.path(); }
+    
+    // How long a file must keep its size before it is taken, in ms.
+    // Overridable with BOOKLET_HOTFOLDER_SETTLE_MS.
+    static int settleMs();
+
+signals:
+    void batchStarted(int batch, int files);
+    void fileFinished(const QString &fileName, bool success, const QString &message);
+
+private slots:
+    void folderChanged();
+    void dispatchSettled();
+
+private:
+    struct Candidate {
+        qint64 size = -1;
+        QDateTime modified;
+    };
+    
+    struct Result {
+        QString inputPath;
+        QString partialOutput;
+        bool success = false;
+        QString message;
+    };
+    
+    // Runs on a pool thread with a creator of its own
+    Result process(const QString &inputPath, const QString &partialOutput) const;
+    void finishFile(const Result &result);
+    // Move into dir, replacing an older file of the same name
+    static bool moveInto(const QString &path, const QDir &dir, const QString &fileName);
+    
+    QDir m_watchDir;
+    QDir m_doneDir;
+    QDir m_failedDir;
+    BookletJob m_job;
+    JobJournal *m_journal;
+    
+    QFileSystemWatcher *m_watcher;
+    QThreadPool m_pool;
+    QTimer m_settleTimer;
+    QElapsedTimer m_waiting;
+    
+    QHash<QString, Candidate> m_candidates;
+    QSet<QString> m_inFlight;
+    int m_batches;
+};
+
+#endif // HOTFOLDER_H
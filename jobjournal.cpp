@@ -0,0 +1,443 @@
+#include "jobjournal.h"
+#include "bookletjob.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <algorithm>
+#include <QSaveFile>
+#include <QSet>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Make a new directory entry durable, so the journal itself survives a
+// crash right after it was created
+void syncDirectory(const QString &path)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+JobJournal::JobJournal(const QString &path)
+    : m_path(path)
+{
+}
+
+JobJournal::~JobJournal()
+{
+    m_file.close();
+}
+
+bool JobJournal::open(QString &error)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    QString directory = QFileInfo(m_path).absolutePath();
+    if (!QDir().mkpath(directory)) {
+        error = "Cannot create job journal directory: " + directory;
+        return false;
+    }
+    bool created = !QFile::exists(m_path);
+    
+    if (!openFile(error)) {
+        return false;
+    }
+    
+    // Replay; a line cut short by a crash does not parse and is skipped
+    m_file.seek(0);
+    QByteArray contents = m_file.readAll();
+    int lines = 0;
+    int skipped = 0;
+    for (const QByteArray &line : contents.split('\n')) {
+        QJsonDocument document = QJsonDocument::fromJson(line);
+        if (document.isObject()) {
+            apply(document.object());
+            ++lines;
+        } else if (!line.trimmed().isEmpty()) {
+            ++skipped;
+        }
+    }
+    if (skipped > 0) {
+        qWarning() << "Job journal" << m_path << ": skipped" << skipped << "damaged line(s)";
+    }
+    
+    // Start the next entry on a line of its own after a torn write
+    if (!contents.isEmpty() && !contents.endsWith('\n')) {
+        m_file.write("\n");
+    }
+    
+    if (created) {
+        syncDirectory(directory);
+    }
+    
+    prune();
+    if (lines + skipped > 2 * compactedEntries().size() && !compact()) {
+        qDebug() << "Job journal" << m_path << "is in use elsewhere; not compacted";
+    }
+    
+    qDebug() << "Job journal" << m_path << "holds" << m_jobs.size() << "job(s)";
+    return true;
+}
+
+bool JobJournal::openFile(QString &error)
+{
+    for (;;) {
+        m_file.close();
+        m_file.setFileName(m_path);
+        if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append | QIODevice::Unbuffered)) {
+            error = "Cannot open job journal " + m_path + ": " + m_file.errorString();
+            return false;
+        }
+        
+        // Other processes appending hold the lock shared; a compaction
+        // holds it exclusively while it replaces the file
+        ::flock(m_file.handle(), LOCK_SH);
+        
+        if (isCurrentFile()) {
+            return true;
+        }
+    }
+}
+
+bool JobJournal::isCurrentFile() const
+{
+    struct stat opened;
+    struct stat current;
+    return ::fstat(m_file.handle(), &opened) != 0
+        || ::stat(QFile::encodeName(m_path).constData(), &current) != 0
+        || (opened.st_dev == current.st_dev && opened.st_ino == current.st_ino);
+}
+
+void JobJournal::restoreSharedLock()
+{
+    ::flock(m_file.handle(), LOCK_SH);
+    if (isCurrentFile()) {
+        return;
+    }
+    QString error;
+    if (!openFile(error)) {
+        qWarning() << error;
+    }
+}
+
+void JobJournal::prune()
+{
+    QDateTime staleBefore = QDateTime::currentDateTimeUtc().addDays(-STALE_JOB_DAYS);
+    for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+        bool givenUp = it->status == "failed" && it->failedAttempts >= MAX_FAILED_ATTEMPTS;
+        bool stale = it->status != "done" && it->lastActivity.isValid() && it->lastActivity < staleBefore;
+        if (givenUp || stale) {
+            qDebug() << "Job journal: giving up on" << it.key() << (givenUp ? "after repeated failures" : "as stale");
+            QDir(it->scratch.isEmpty() ? scratchPath(it.key()) : it->scratch).removeRecursively();
+            it = m_jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QList<QJsonObject> JobJournal::compactedEntries() const
+{
+    QList<QString> keys = m_jobs.keys();
+    std::sort(keys.begin(), keys.end(), [this](const QString &a, const QString &b) {
+        return m_jobs.constFind(a)->sequence < m_jobs.constFind(b)->sequence;
+    });
+    
+    QList<QJsonObject> entries;
+    for (const QString &key : keys) {
+        const JobState &state = *m_jobs.constFind(key);
+        QString time = state.lastActivity.toString(Qt::ISODateWithMs);
+        
+        // A finished job only needs its output checksum
+        if (state.status == "done") {
+            entries.append(QJsonObject{{"event", "done"}, {"key", key}, {"output", state.output},
+                                       {"sha256", QString::fromLatin1(state.outputSha256)},
+                                       {"time", time}});
+            continue;
+        }
+        
+        entries.append(QJsonObject{{"event", "start"}, {"key", key}, {"job", state.job},
+                                   {"origin", state.origin}, {"scratch", state.scratch},
+                                   {"time", time}});
+        for (auto stage = state.stages.constBegin(); stage != state.stages.constEnd(); ++stage) {
+            entries.append(QJsonObject{{"event", "stage"}, {"key", key}, {"stage", stage.key()},
+                                       {"artifact", stage->path},
+                                       {"sha256", QString::fromLatin1(stage->sha256)},
+                                       {"time", time}});
+        }
+        if (state.status == "failed") {
+            entries.append(QJsonObject{{"event", "failed"}, {"key", key}, {"message", state.message},
+                                       {"attempts", state.failedAttempts}, {"time", time}});
+        }
+    }
+    return entries;
+}
+
+bool JobJournal::compact()
+{
+    // Appends from another process would be lost with the old file
+    if (::flock(m_file.handle(), LOCK_EX | LOCK_NB) != 0) {
+        restoreSharedLock();
+        return false;
+    }
+    
+    // The conversion is not atomic: another process may have compacted
+    // in the gap, and its file holds appends this one never replayed
+    if (!isCurrentFile()) {
+        restoreSharedLock();
+        return false;
+    }
+    
+    QSaveFile rewritten(m_path);
+    if (!rewritten.open(QIODevice::WriteOnly)) {
+        restoreSharedLock();
+        return false;
+    }
+    QList<QJsonObject> entries = compactedEntries();
+    for (const QJsonObject &entry : entries) {
+        rewritten.write(QJsonDocument(entry).toJson(QJsonDocument::Compact) + "\n");
+    }
+    if (!rewritten.commit()) {
+        qWarning() << "Cannot compact job journal" << m_path << ":" << rewritten.errorString();
+        restoreSharedLock();
+        return false;
+    }
+    syncDirectory(QFileInfo(m_path).absolutePath());
+    
+    // Nobody else has the journal open, so scratch directories no job in it
+    // owns are leftovers
+    QSet<QString> owned;
+    for (auto it = m_jobs.constBegin(); it != m_jobs.constEnd(); ++it) {
+        if (it->status != "done") {
+            owned.insert(QFileInfo(it->scratch.isEmpty() ? scratchPath(it.key()) : it->scratch).fileName());
+        }
+    }
+    QDir scratchRoot(QFileInfo(m_path).absoluteDir().filePath("scratch"));
+    for (const QString &name : scratchRoot.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (!owned.contains(name)) {
+            QDir(scratchRoot.filePath(name)).removeRecursively();
+        }
+    }
+    
+    // Closing the replaced file drops the exclusive lock
+    QString error;
+    if (!openFile(error)) {
+        qWarning() << error;
+    }
+    qDebug() << "Compacted job journal" << m_path << "to" << entries.size() << "line(s)";
+    return true;
+}
+
+bool JobJournal::isCompleted(const QString &key, const QString &outputPath)
+{
+    QByteArray recorded;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_jobs.constFind(key);
+        if (it == m_jobs.constEnd() || it->status != "done") {
+            return false;
+        }
+        recorded = it->outputSha256;
+    }
+    return !recorded.isEmpty() && fileChecksum(outputPath) == recorded;
+}
+
+QList<QJsonObject> JobJournal::interruptedJobs(const QString &origin)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    QList<const JobState *> interrupted;
+    for (const JobState &state : std::as_const(m_jobs)) {
+        if (state.status == "running" && state.origin == origin) {
+            interrupted.append(&state);
+        }
+    }
+    std::sort(interrupted.begin(), interrupted.end(),
+              [](const JobState *a, const JobState *b) { return a->sequence < b->sequence; });
+    
+    QList<QJsonObject> jobs;
+    for (const JobState *state : interrupted) {
+        jobs.append(state->job);
+    }
+    return jobs;
+}
+
+QString JobJournal::scratchPath(const QString &key)
+{
+    return QFileInfo(m_path).absoluteDir().filePath("scratch/" + key);
+}
+
+QString JobJournal::completedArtifact(const QString &key, const QString &stage)
+{
+    Artifact artifact;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_jobs.constFind(key);
+        if (it == m_jobs.constEnd() || !it->stages.contains(stage)) {
+            return QString();
+        }
+        artifact = it->stages.value(stage);
+    }
+    
+    // A file half written when the crash hit does not count
+    if (artifact.sha256.isEmpty() || fileChecksum(artifact.path) != artifact.sha256) {
+        qDebug() << "Checkpoint for" << stage << "no longer intact:" << artifact.path;
+        return QString();
+    }
+    return artifact.path;
+}
+
+bool JobJournal::recordStart(const QString &key, const BookletJob &job, const QString &origin)
+{
+    QJsonObject entry;
+    entry["event"] = "start";
+    entry["key"] = key;
+    entry["job"] = job.toJson();
+    entry["origin"] = origin;
+    entry["scratch"] = scratchPath(key);
+    return append(entry);
+}
+
+bool JobJournal::recordStage(const QString &key, const QString &stage, const QString &artifactPath)
+{
+    // The artifact must be on disk before the journal says it is
+    QFile artifact(artifactPath);
+    if (artifact.open(QIODevice::ReadOnly)) {
+        ::fsync(artifact.handle());
+    }
+    
+    QJsonObject entry;
+    entry["event"] = "stage";
+    entry["key"] = key;
+    entry["stage"] = stage;
+    entry["artifact"] = artifactPath;
+    entry["sha256"] = QString::fromLatin1(fileChecksum(artifactPath));
+    return append(entry);
+}
+
+bool JobJournal::recordFinish(const QString &key, bool success, const QString &outputPath,
+                              const QString &message)
+{
+    QJsonObject entry;
+    entry["key"] = key;
+    if (success) {
+        QFile output(outputPath);
+        if (output.open(QIODevice::ReadOnly)) {
+            ::fsync(output.handle());
+        }
+        entry["event"] = "done";
+        entry["output"] = outputPath;
+        entry["sha256"] = QString::fromLatin1(fileChecksum(outputPath));
+    } else {
+        entry["event"] = "failed";
+        entry["message"] = message;
+    }
+    
+    if (!append(entry)) {
+        return false;
+    }
+    
+    bool givenUp = false;
+    if (!success) {
+        QMutexLocker locker(&m_mutex);
+        JobState &state = m_jobs[key];
+        givenUp = state.failedAttempts >= MAX_FAILED_ATTEMPTS;
+        if (givenUp) {
+            // The next attempt starts from scratch
+            state.stages.clear();
+        }
+    }
+    if (success || givenUp) {
+        QDir(scratchPath(key)).removeRecursively();
+    }
+    return true;
+}
+
+QByteArray JobJournal::fileChecksum(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(&file);
+    return hash.result().toHex();
+}
+
+QString JobJournal::defaultPath()
+{
+    QString path = qEnvironmentVariable("BOOKLET_JOURNAL");
+    if (!path.isEmpty()) {
+        return path;
+    }
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+        .filePath("job-journal.jsonl");
+}
+
+void JobJournal::apply(const QJsonObject &entry)
+{
+    QString event = entry["event"].toString();
+    JobState &state = m_jobs[entry["key"].toString()];
+    state.lastActivity = QDateTime::fromString(entry["time"].toString(), Qt::ISODateWithMs);
+    
+    if (event == "start") {
+        // A new attempt keeps the checkpoints of the earlier ones
+        state.status = "running";
+        state.origin = entry["origin"].toString();
+        state.job = entry["job"].toObject();
+        state.scratch = entry["scratch"].toString();
+        state.outputSha256.clear();
+        state.sequence = ++m_sequence;
+    } else if (event == "stage") {
+        Artifact artifact;
+        artifact.path = entry["artifact"].toString();
+        artifact.sha256 = entry["sha256"].toString().toLatin1();
+        state.stages.insert(entry["stage"].toString(), artifact);
+    } else if (event == "done") {
+        state.status = "done";
+        state.output = entry["output"].toString();
+        state.outputSha256 = entry["sha256"].toString().toLatin1();
+        state.stages.clear();
+        state.failedAttempts = 0;
+    } else if (event == "failed") {
+        // A compacted journal carries the count; otherwise each line is one
+        state.status = "failed";
+        state.message = entry["message"].toString();
+        state.failedAttempts = entry.contains("attempts") ? entry["attempts"].toInt()
+                                                          : state.failedAttempts + 1;
+    }
+}
+
+bool JobJournal::append(QJsonObject entry)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    entry["time"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    apply(entry);
+    
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    
+    // One write per line: with O_APPEND, lines from a daemon and a batch run
+    // sharing the journal never interleave
+    QByteArray line = QJsonDocument(entry).toJson(QJsonDocument::Compact) + "\n";
+    if (m_file.write(line) != line.size() || ::fsync(m_file.handle()) != 0) {
+        qWarning() << "Cannot write job journal" << m_path << ":" << m_file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef JOBJOURNAL_H
+#define JOBJOURNAL_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+struct BookletJob;
+
+// Append-only record of booklet jobs, one JSON object per line, each line
+// fsync'ed before the call returns:
+//
+//   {"event": "start",  "key", "job", "origin", "scratch"}
+//   {"event": "stage",  "key", "stage", "artifact", "sha256"}
+//   {"event": "done",   "key", "output", "sha256"}
+//   {"event": "failed", "key", "message", "attempts"}
+//
+// Jobs are identified by BookletJob::journalKey(), so the same job submitted
+// again after a crash finds its earlier attempt. Intermediates of completed
+// stages are kept in a per-job scratch directory next to the journal until
+// the job is done; a torn last line from a crash is skipped on replay.
+//
+// A job that failed MAX_FAILED_ATTEMPTS times, or that has not moved for
+// STALE_JOB_DAYS, is given up: its scratch directory is removed and its
+// checkpoints are forgotten. When most lines on replay are obsolete and no
+// other process has the journal open, it is rewritten with one line per
+// live fact, and scratch directories no job owns are removed.
+class JobJournal
+{
+public:
+    explicit JobJournal(const QString &path = defaultPath());
+    ~JobJournal();
+    
+    // Replay the existing journal, prune and compact it, and open it for
+    // appending
+    bool open(QString &error);
+    QString path() const { return m_path; }
+    
+    // True if the job finished earlier and its output still has the
+    // checksum recorded then
+    bool isCompleted(const QString &key, const QString &outputPath);
+    
+    // Jobs started by origin that neither finished nor failed, oldest first,
+    // as BookletJob JSON
+    QList<QJsonObject> interruptedJobs(const QString &origin);
+    
+    // Durable scratch directory for a job, kept across restarts until the
+    // job is done
+    QString scratchPath(const QString &key);
+    
+    // Artifact a stage produced in an earlier attempt, if it is still
+    // intact; empty otherwise
+    QString completedArtifact(const QString &key, const QString &stage);
+    
+    bool recordStart(const QString &key, const BookletJob &job, const QString &origin);
+    bool recordStage(const QString &key, const QString &stage, const QString &artifactPath);
+    // A finished job's scratch directory is removed; a failed job keeps it
+    // for the next attempt until it has failed MAX_FAILED_ATTEMPTS times
+    bool recordFinish(const QString &key, bool success, const QString &outputPath,
+                      const QString &message);
+    
+    // SHA-256 of a file in hex, or empty if it cannot be read
+    static QByteArray fileChecksum(const QString &path);
+    
+    // BOOKLET_JOURNAL, or job-journal.jsonl in the app data directory
+    static QString defaultPath();
+    
+    static const int MAX_FAILED_ATTEMPTS = 3;
+    static const int STALE_JOB_DAYS = 7;
+
+private:
+    struct Artifact {
+        QString path;
+        QByteArray sha256;
+    };
+    
+    struct JobState {
+        QString status;             // running, done or failed
+        QString origin;
+        QJsonObject job;
+        QString scratch;
+        QHash<QString, Artifact> stages;
+        QString output;
+        QByteArray outputSha256;
+        QString message;
+        int failedAttempts = 0;
+        QDateTime lastActivity;
+        qint64 sequence = 0;
+    };
+    
+    void apply(const QJsonObject &entry);
+    bool append(QJsonObject entry);
+    
+    // Open m_path for appending under a shared lock, making sure the file
+    // locked is the one at m_path and not one a compaction just replaced
+    bool openFile(QString &error);
+    // True unless a compaction has replaced the file m_file has open
+    bool isCurrentFile() const;
+    // Go back to a shared lock after trying for an exclusive one. flock
+    // drops the old lock before converting, so another process may have
+    // compacted the journal in between; reopen it if so.
+    void restoreSharedLock();
+    // Forget failed and stale jobs and remove their scratch directories
+    void prune();
+    // The journal as the fewest lines that replay to the current state
+    QList<QJsonObject> compactedEntries() const;
+    // Rewrite the journal from compactedEntries() if no other process has
+    // it open; returns false if it was left as is
+    bool compact();
+    
+    QString m_path;
+    QFile m_file;
+    QMutex m_mutex;
+    QHash<QString, JobState> m_jobs;
+    qint64 m_sequence = 0;
+};
+
+#endif // JOBJOURNAL_H
@@ -1,19 +1,368 @@
+#include "bookletclient.h"
+#include "bookletdaemon.h"
+#include "hotfolder.h"
+#include "jobjournal.h"
 #include "mainwindow.h"
+#include "pdfbookletcreator.h"
+#include "progressestimator.h"
+#include "spawnhelper.h"
+#include "stagetracer.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QScopedPointer>
 #include <QStyleFactory>
+#include <QTextStream>
+#include <QThread>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// Batch, daemon, submit and watch runs must work without a display, so they are
+// detected before the application object is created
+bool isHeadlessRun(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch") == 0
+            || std::strcmp(argv[i], "--daemon") == 0
+            || std::strcmp(argv[i], "--submit") == 0
+            || std::strcmp(argv[i], "--watch") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Print "NN%  stage  about m:ss left" lines to stderr for anything with the
+// creator's progress signals
+template <typename Source>
+void printProgress(Source *source, QTextStream &err)
+{
+    auto stage = std::make_shared<QString>();
+    auto remainingMs = std::make_shared<qint64>(-1);
+    
+    QObject::connect(source, &Source::etaChanged,
+                     [stage, remainingMs](qint64 remaining, const QString &currentStage) {
+                         *remainingMs = remaining;
+                         if (!currentStage.isEmpty()) {
+                             *stage = currentStage;
+                         }
+                     });
+    QObject::connect(source, &Source::progressChanged, [&err, stage, remainingMs](int progress) {
+        err << QString("%1%").arg(progress, 3) << "  " << stage->leftJustified(10)
+            << ProgressEstimator::formatRemaining(*remainingMs) << "\n";
+        err.flush();
+    });
+}
+
+// Print a "Sheets a-b of n ready: <part>" line to stderr for every part a
+// streaming job publishes, for a spooler reading along
+template <typename Source>
+void printSheets(Source *source, QTextStream &err)
+{
+    QObject::connect(source, &Source::sheetsReady,
+                     [&err](int firstSheet, int lastSheet, int sheetCount, const QString &partPath) {
+                         err << "Sheets " << firstSheet << "-" << lastSheet << " of " << sheetCount
+                             << " ready: " << partPath << "\n";
+                         err.flush();
+                     });
+}
+
+// Layout and optimizer options shared by --batch, --submit and --watch
+BookletJob optionsFromArguments(const QCommandLineParser &parser, const QString &layout)
+{
+    BookletJob job;
+    job.layout = layout;
+    job.optimizer.deduplicateResources = parser.isSet("dedup");
+    job.optimizer.downsampleDpi = qMax(0, parser.value("downsample-dpi").toInt());
+    job.optimizer.objectStreams = parser.isSet("object-streams");
+    job.optimizer.compressionLevel = qBound(-1, parser.value("compression-level").toInt(), 9);
+    job.optimizer.parallelCompression = parser.isSet("parallel-compression");
+    job.optimizer.linearize = parser.isSet("linearize");
+    return job;
+}
+
+BookletJob jobFromArguments(const QCommandLineParser &parser, const QString &layout)
+{
+    const QStringList files = parser.positionalArguments();
+    BookletJob job = optionsFromArguments(parser, layout);
+    job.inputPath = QFileInfo(files.at(0)).absoluteFilePath();
+    job.outputPath = QFileInfo(files.at(1)).absoluteFilePath();
+    job.streaming = parser.isSet("streaming");
+    return job;
+}
+
+// Open the journal named on the command line, or return nullptr if it is
+// turned off or cannot be used; jobs then simply run without resume
+std::unique_ptr<JobJournal> openJournal(const QString &path, QTextStream &err)
+{
+    if (path.isEmpty()) {
+        return nullptr;
+    }
+    auto journal = std::make_unique<JobJournal>(path);
+    QString error;
+    if (!journal->open(error)) {
+        err << error << " (continuing without resume)\n";
+        return nullptr;
+    }
+    return journal;
+}
+
+// Lay out one file without the GUI, printing progress and time left to stderr.
+// A job the journal has seen finish, with its output untouched, is skipped;
+// an interrupted one resumes after its last completed stage.
+int runBatch(const QCommandLineParser &parser, const QString &layout, const QString &journalPath)
+{
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 2) {
+        err << "--batch needs an input and an output file\n";
+        return 2;
+    }
+    
+    BookletJob job = jobFromArguments(parser, layout);
+    QString error;
+    if (!job.isValid(error)) {
+        err << error << "\n";
+        return 2;
+    }
+    
+    std::unique_ptr<JobJournal> journal = openJournal(journalPath, err);
+    if (journal && journal->isCompleted(job.journalKey(), job.outputPath)) {
+        err << "Already done: " << job.outputPath << "\n";
+        return 0;
+    }
+    
+    PathConfig::initialize();
+    
+    QPDFBookletCreator creator;
+    bool succeeded = false;
+    QString message;
+    
+    printProgress(&creator, err);
+    printSheets(&creator, err);
+    QObject::connect(&creator, &QPDFBookletCreator::processingComplete,
+                     [&](bool success, const QString &text) {
+                         succeeded = success;
+                         message = text;
+                     });
+    
+    job.run(creator, journal.get(), "batch");
+    
+    err << (succeeded ? "" : "Failed: ") << message << "\n";
+    return succeeded ? 0 : 1;
+}
+
+// Serve jobs over a local socket until killed
+int runDaemon(QCoreApplication &app, const QString &socketName, const QString &journalPath)
+{
+    QTextStream err(stderr);
+    std::unique_ptr<JobJournal> journal = openJournal(journalPath, err);
+    BookletDaemon daemon;
+    daemon.setJournal(journal.get());
+    QString error;
+    if (!daemon.listen(socketName, error)) {
+        err << error << "\n";
+        return 1;
+    }
+    
+    err << "Listening on " << socketName << "\n";
+    err.flush();
+    return app.exec();
+}
+
+// Lay out every PDF dropped into a folder until killed
+int runWatch(QCoreApplication &app, const QString &folder, const BookletJob &options,
+             int workers, const QString &journalPath)
+{
+    QTextStream err(stderr);
+    if (options.layout != "booklet" && options.layout != "2up" && options.layout != "sequential") {
+        err << "Unknown layout: " << options.layout << "\n";
+        return 2;
+    }
+    
+    std::unique_ptr<JobJournal> journal = openJournal(journalPath, err);
+    
+    PathConfig::initialize();
+    
+    HotFolder hotFolder(folder, options, workers, journal.get());
+    QObject::connect(&hotFolder, &HotFolder::batchStarted, [&err](int batch, int files) {
+        err << "Batch " << batch << ": " << files << " file(s)\n";
+        err.flush();
+    });
+    QObject::connect(&hotFolder, &HotFolder::fileFinished,
+                     [&err](const QString &fileName, bool success, const QString &message) {
+                         err << (success ? "Done: " : "Failed: ") << fileName
+                             << (success ? QString() : " - " + message) << "\n";
+                         err.flush();
+                     });
+    
+    QString error;
+    if (!hotFolder.start(error)) {
+        err << error << "\n";
+        return 1;
+    }
+    
+    err << "Watching " << folder << "; results go to " << hotFolder.donePath()
+        << " and " << hotFolder.failedPath() << "\n";
+    err.flush();
+    return app.exec();
+}
+
+// Hand one file to a running daemon and wait for it, printing progress like
+// --batch does
+int runSubmit(const QCommandLineParser &parser, const QString &layout,
+              const QString &socketName, int priority)
+{
+    QTextStream err(stderr);
+    if (parser.positionalArguments().size() != 2) {
+        err << "--submit needs an input and an output file\n";
+        return 2;
+    }
+    
+    BookletJob job = jobFromArguments(parser, layout);
+    job.priority = priority;
+    
+    BookletClient client(socketName);
+    printProgress(&client, err);
+    printSheets(&client, err);
+    
+    QString error;
+    if (!client.submit(job, error)) {
+        err << error << "\n";
+        return 2;
+    }
+    
+    bool succeeded = client.waitForFinished();
+    err << (succeeded ? "" : "Failed: ") << client.message() << "\n";
+    return succeeded ? 0 : 1;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // Fork the spawn helper while the process is still small and has a
+    // single thread
+    SpawnHelper::start();
     
-    // Set fusion style for a modern look
-    a.setStyle(QStyleFactory::create("Fusion"));
+    QScopedPointer<QCoreApplication> a(isHeadlessRun(argc, argv)
+                                       ? new QCoreApplication(argc, argv)
+                                       : new QApplication(argc, argv));
     
     // Set application info
-    QApplication::setApplicationName("A6 Booklet Maker");
-    QApplication::setApplicationVersion("1.0");
-    QApplication::setOrganizationName("YourCompany");
-    QApplication::setOrganizationDomain("yourcompany.com");
+    QCoreApplication::setApplicationName("A6 Booklet Maker");
+    QCoreApplication::setApplicationVersion("1.0");
+    QCoreApplication::setOrganizationName("YourCompany");
+    QCoreApplication::setOrganizationDomain("yourcompany.com");
+    
+    // Command line options
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Arrange A6 pages into booklets printed on A4 sheets.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption traceOption("trace",
+        "Write a Chrome trace of every booklet job to <file> (same as BOOKLET_TRACE).", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption batchOption("batch",
+        "Lay out <input> into <output> without the GUI, printing progress to stderr.");
+    parser.addOption(batchOption);
+    QCommandLineOption layoutOption("layout",
+        "Layout for --batch, --submit and --watch: booklet (default), 2up or sequential.", "layout", "booklet");
+    parser.addOption(layoutOption);
+    QCommandLineOption streamingOption("streaming",
+        "Publish sheets into <output>.parts/ as they finish (--batch and --submit), "
+        "printing a line for each part.");
+    parser.addOption(streamingOption);
+    QCommandLineOption dedupOption("dedup",
+        "Merge identical images, fonts and ICC profiles across pages (--batch, --submit, --watch).");
+    parser.addOption(dedupOption);
+    QCommandLineOption downsampleOption("downsample-dpi",
+        "Downsample images printed above <dpi> (--batch, --submit, --watch; default 0, off).", "dpi", "0");
+    parser.addOption(downsampleOption);
+    QCommandLineOption objectStreamsOption("object-streams",
+        "Pack objects into object streams (--batch, --submit, --watch).");
+    parser.addOption(objectStreamsOption);
+    QCommandLineOption compressionLevelOption("compression-level",
+        "zlib level 1-9 for rewritten streams (--batch, --submit, --watch; default -1, zlib's).", "level", "-1");
+    parser.addOption(compressionLevelOption);
+    QCommandLineOption parallelCompressionOption("parallel-compression",
+        "Compress streams on all cores (--batch, --submit, --watch).");
+    parser.addOption(parallelCompressionOption);
+    QCommandLineOption linearizeOption("linearize",
+        "Linearize the output for fast first-page display (--batch, --submit, --watch).");
+    parser.addOption(linearizeOption);
+    QCommandLineOption verboseOption("verbose", "Keep debug output in --batch, --submit and --watch mode.");
+    parser.addOption(verboseOption);
+    QCommandLineOption daemonOption("daemon",
+        "Run as a headless print server, taking jobs over a local socket.");
+    parser.addOption(daemonOption);
+    QCommandLineOption submitOption("submit",
+        "Send <input> and <output> to a running daemon instead of laying them out here.");
+    parser.addOption(submitOption);
+    QCommandLineOption socketOption("socket",
+        "Local socket name for --daemon and --submit.", "name", BookletDaemon::defaultSocketName());
+    parser.addOption(socketOption);
+    QCommandLineOption watchOption("watch",
+        "Lay out every PDF dropped into <folder> once it stops growing; results go to "
+        "the sibling folders <folder>-done and <folder>-failed.", "folder");
+    parser.addOption(watchOption);
+    QCommandLineOption workersOption("workers",
+        "Jobs laid out at once in --watch mode (default: half the cores).", "n",
+        QString::number(qMax(1, QThread::idealThreadCount() / 2)));
+    parser.addOption(workersOption);
+    QCommandLineOption journalOption("journal",
+        "Job journal for --batch, --daemon and --watch, used to skip finished jobs and resume "
+        "interrupted ones (default: BOOKLET_JOURNAL or the app data directory).",
+        "file", JobJournal::defaultPath());
+    parser.addOption(journalOption);
+    QCommandLineOption noJournalOption("no-journal", "Run --batch, --daemon or --watch without a job journal.");
+    parser.addOption(noJournalOption);
+    QCommandLineOption priorityOption("priority",
+        "Queue priority for --submit; higher runs first.", "n", "0");
+    parser.addOption(priorityOption);
+    parser.addPositionalArgument("input", "PDF with A6 pages (--batch and --submit only).");
+    parser.addPositionalArgument("output", "Booklet PDF to write (--batch and --submit only).");
+    parser.process(*a);
+    
+    if (parser.isSet(traceOption)) {
+        StageTracer::instance().setOutputPath(parser.value(traceOption));
+    }
+    
+    QString journalPath = parser.isSet(noJournalOption) ? QString() : parser.value(journalOption);
+    
+    if (parser.isSet(batchOption)) {
+        if (!parser.isSet(verboseOption)) {
+            // Keep the progress lines readable
+            QLoggingCategory::setFilterRules("*.debug=false");
+        }
+        return runBatch(parser, parser.value(layoutOption), journalPath);
+    }
+    
+    if (parser.isSet(daemonOption)) {
+        return runDaemon(*a, parser.value(socketOption), journalPath);
+    }
+    
+    if (parser.isSet(watchOption)) {
+        if (!parser.isSet(verboseOption)) {
+            QLoggingCategory::setFilterRules("*.debug=false");
+        }
+        return runWatch(*a, parser.value(watchOption),
+                        optionsFromArguments(parser, parser.value(layoutOption)),
+                        parser.value(workersOption).toInt(), journalPath);
+    }
+    
+    if (parser.isSet(submitOption)) {
+        if (!parser.isSet(verboseOption)) {
+            QLoggingCategory::setFilterRules("*.debug=false");
+        }
+        return runSubmit(parser, parser.value(layoutOption), parser.value(socketOption),
+                         parser.value(priorityOption).toInt());
+    }
+    
+    // Set fusion style for a modern look
+    QApplication::setStyle(QStyleFactory::create("Fusion"));
     
     // Set a modern color palette
     QPalette palette;
@@ -32,10 +381,10 @@ int main(int argc, char *argv[])
     palette.setColor(QPalette::HighlightedText, Qt::black);
     
     // Uncomment to use the dark theme
-    // a.setPalette(palette);
+    // QApplication::setPalette(palette);
     
     MainWindow w;
     w.show();
     
-    return a.exec();
+    return a->exec();
 }
@@ -1,30 +1,36 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "bookletclient.h"
+#include "bookletdaemon.h"
+#include <QDebug>
 #include <QDir>
+#include <QFileInfo>
 #include <QStandardPaths>
 #include <QDialog>
 #include <QVBoxLayout>
 #include <QProcess>
-
-QString PathConfig::qpdfPath("/opt/homebrew/bin/qpdf");
-QString PathConfig::pdfjamPath("/opt/homebrew/bin/pdfjam");
+#include <QSettings>
+#include <QShowEvent>
+#include <QTimer>
+#include <QtConcurrent>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     bookletCreator(new QPDFBookletCreator(this)),
-    previewWidget(nullptr)
+    previewWidget(nullptr),
+    dependencyWatcher(new QFutureWatcher<PathConfig::DependencyStatus>(this))
 {
     ui->setupUi(this);
     
     // Set window title
     setWindowTitle("A6 to A4 Booklet Maker");
     
-    // Check if required dependencies are installed
-    if (!checkDependencies()) {
-        QMessageBox::warning(this, "Missing Dependencies",
-                            "Some required dependencies are missing. The application may not work correctly.");
-    }
+    // Dependencies are checked in the background once the window is up
+    connect(dependencyWatcher, &QFutureWatcher<PathConfig::DependencyStatus>::finished,
+            this, &MainWindow::dependencyCheckFinished);
+    
+    setupOutputMenu();
     
     // Initialize UI
     updateUI();
@@ -32,17 +38,16 @@ MainWindow::MainWindow(QWidget *parent) :
     // Connect signals/slots for the booklet creator
     connect(bookletCreator, &QPDFBookletCreator::progressChanged, 
             [this](int progress) {
-                // Update progress dialog if needed
+                if (progressDialog) {
+                    progressDialog->setValue(progress);
+                }
             });
+    connect(bookletCreator, &QPDFBookletCreator::etaChanged, this, &MainWindow::showEta);
     
     connect(bookletCreator, &QPDFBookletCreator::processingComplete, 
             [this](bool success, const QString &message) {
-                if (success) {
-                    QMessageBox::information(this, "Success", 
-                                           "Booklet created successfully!\n\n" + message);
-                } else {
-                    showError("Failed to create booklet: " + message);
-                }
+                endJob();
+                reportResult(success, message);
             });
     
     // Default output directory is Desktop
@@ -56,22 +61,82 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-bool MainWindow::checkDependencies() 
+void MainWindow::setupOutputMenu()
 {
-    bool allDepsPresent = true;
-    QString missingDeps;
+    QMenu *outputMenu = new QMenu("Output", this);
+    ui->menuBar->insertMenu(ui->menuHelp->menuAction(), outputMenu);
     
-    allDepsPresent = PathConfig::checkDependencies(missingDeps);
+    QSettings settings;
+    auto addOption = [&](const QString &text, const QString &key) {
+        QAction *action = outputMenu->addAction(text);
+        action->setCheckable(true);
+        action->setChecked(settings.value("output/" + key, false).toBool());
+        connect(action, &QAction::toggled, this, [key](bool checked) {
+            QSettings().setValue("output/" + key, checked);
+        });
+        return action;
+    };
+    dedupAction = addOption("Merge Duplicate Images and Fonts", "deduplicate");
+    downsampleAction = addOption("Downsample Images to 300 DPI", "downsample");
+    outputMenu->addSeparator();
+    objectStreamsAction = addOption("Compact Object Streams", "objectStreams");
+    parallelCompressionAction = addOption("Compress on All Cores", "parallelCompression");
+    linearizeAction = addOption("Fast Web View", "linearize");
+}
+
+BookletJob MainWindow::currentJob() const
+{
+    BookletJob job;
+    job.inputPath = QFileInfo(inputFilePath).absoluteFilePath();
+    job.outputPath = QFileInfo(outputFilePath).absoluteFilePath();
+    job.startFromBeginning = ui->startFromBeginningCheckBox->isChecked();
+    job.optimizer.deduplicateResources = dedupAction->isChecked();
+    job.optimizer.downsampleDpi = downsampleAction->isChecked() ? 300 : 0;
+    job.optimizer.objectStreams = objectStreamsAction->isChecked();
+    job.optimizer.parallelCompression = parallelCompressionAction->isChecked();
+    job.optimizer.linearize = linearizeAction->isChecked();
+    return job;
+}
+
+void MainWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
     
-    if (!allDepsPresent) {
-        QMessageBox::warning(this, "Missing Dependencies",
-                            "The following dependencies are missing:\n" + missingDeps + 
-                            "\nPlease install them using Homebrew:\n" +
-                            "brew install qpdf\n" +
-                            "brew install texlive-core");
+    // Locating and probing the tools spawns several processes. Queue it
+    // behind the update requests posted by show() so the window paints first.
+    if (!dependencyCheckStarted) {
+        dependencyCheckStarted = true;
+        QTimer::singleShot(0, this, &MainWindow::startDependencyCheck);
+    }
+}
+
+void MainWindow::startDependencyCheck()
+{
+    ui->statusBar->showMessage("Checking for qpdf, pdfjam and pdflatex...");
+    // Only computes the paths; they are applied on this thread when it ends
+    dependencyWatcher->setFuture(QtConcurrent::run(&PathConfig::dependencyStatus));
+}
+
+void MainWindow::dependencyCheckFinished()
+{
+    dependencyStatus = dependencyWatcher->result();
+    dependencyCheckDone = true;
+    PathConfig::apply(dependencyStatus);
+    
+    if (dependencyStatus.missingDeps.isEmpty()) {
+        ui->statusBar->showMessage("All dependencies found.", 5000);
+    } else if (dependencyStatus.canLayOut()) {
+        // Nothing the layouts need is missing
+        QString missing = dependencyStatus.missingDeps.trimmed().replace("\n", ", ").remove("- ");
+        ui->statusBar->showMessage("Optional tools missing: " + missing, 5000);
+    } else {
+        QString missing = dependencyStatus.missingDeps.trimmed().replace("\n", ", ").remove("- ");
+        ui->statusBar->showMessage("Booklet creation disabled, missing: " + missing +
+                                   ". Install with: brew install qpdf texlive-core");
+        ui->createBookletButton->setToolTip("Missing dependencies:\n" + dependencyStatus.missingDeps);
     }
     
-    return allDepsPresent;
+    updateUI();
 }
 
 void MainWindow::on_browseButton_clicked()
@@ -121,18 +186,90 @@ void MainWindow::on_createBookletButton_clicked()
         return;
     }
     
+    if (progressDialog) {
+        return;
+    }
+    
     // Create progress dialog
-    QProgressDialog progressDialog("Creating booklet...", "Cancel", 0, 100, this);
-    progressDialog.setWindowModality(Qt::WindowModal);
-    progressDialog.show();
+    progressDialog = new QProgressDialog("Creating booklet...", "Cancel", 0, 100, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setAutoReset(false);
+    progressDialog->show();
+    updateUI();
     
-    // Connect progress updates
-    connect(bookletCreator, &QPDFBookletCreator::progressChanged,
-            &progressDialog, &QProgressDialog::setValue);
+    BookletJob job = currentJob();
     
-    // Create the booklet
-    bool startFromBeginning = ui->startFromBeginningCheckBox->isChecked();
-    bookletCreator->createBooklet(inputFilePath, outputFilePath, startFromBeginning);
+    // A running daemon already has its tools resolved and caches warm. The
+    // submission runs on this event loop; with no daemon listening the
+    // connect fails at once and the job runs here instead.
+    daemonClient = new BookletClient(BookletDaemon::defaultSocketName(), this);
+    connect(daemonClient, &BookletClient::progressChanged, progressDialog, &QProgressDialog::setValue);
+    connect(daemonClient, &BookletClient::etaChanged, this, &MainWindow::showEta);
+    connect(daemonClient, &BookletClient::processingComplete, this,
+            [this](bool success, const QString &message) {
+                endJob();
+                reportResult(success, message);
+            });
+    connect(daemonClient, &BookletClient::failed, this, [this, job](const QString &error) {
+        if (!daemonClient->jobId().isEmpty()) {
+            endJob();
+            showError(error);
+            return;
+        }
+        qDebug() << "No daemon, creating the booklet here:" << error;
+        daemonClient->deleteLater();
+        daemonClient = nullptr;
+        createLocally(job);
+    });
+    connect(progressDialog, &QProgressDialog::canceled, this, [this]() {
+        // A queued job is dropped; a running one finishes in the daemon,
+        // but nobody waits for it any more
+        if (daemonClient) {
+            daemonClient->cancel();
+            ui->statusBar->showMessage("Stopped waiting for the booklet daemon.", 5000);
+        }
+        endJob();
+    });
+    daemonClient->submitAsync(job);
+}
+
+void MainWindow::createLocally(const BookletJob &job)
+{
+    // The layout blocks this thread until it is done, so there is no
+    // point at which it could be cancelled
+    progressDialog->setCancelButton(nullptr);
+    
+    // processingComplete closes the dialog and reports the result
+    job.run(*bookletCreator);
+}
+
+void MainWindow::showEta(qint64 remainingMs, const QString &stage)
+{
+    if (!progressDialog) {
+        return;
+    }
+    QString label = "Creating booklet...\n" + ProgressEstimator::formatRemaining(remainingMs);
+    if (!stage.isEmpty()) {
+        label += " (" + stage + ")";
+    }
+    progressDialog->setLabelText(label);
+}
+
+void MainWindow::endJob()
+{
+    if (daemonClient) {
+        // Deleting the client closes its connection
+        daemonClient->disconnect(this);
+        daemonClient->deleteLater();
+        daemonClient = nullptr;
+    }
+    if (progressDialog) {
+        progressDialog->disconnect(this);
+        progressDialog->close();
+        progressDialog->deleteLater();
+        progressDialog = nullptr;
+    }
+    updateUI();
 }
 
 void MainWindow::on_previewButton_clicked()
@@ -198,10 +335,24 @@ void MainWindow::updateUI()
     bool hasInputFile = !inputFilePath.isEmpty();
     bool hasOutputFile = !outputFilePath.isEmpty();
     
-    ui->createBookletButton->setEnabled(hasInputFile && hasOutputFile);
+    // Each action waits for the background check to find the tools it runs;
+    // the preview renders in process and needs none
+    bool canLayOut = dependencyCheckDone && dependencyStatus.canLayOut();
+    
+    ui->createBookletButton->setEnabled(hasInputFile && hasOutputFile && canLayOut && !progressDialog);
     ui->previewButton->setEnabled(hasInputFile);
 }
 
+void MainWindow::reportResult(bool success, const QString &message)
+{
+    if (success) {
+        QMessageBox::information(this, "Success", 
+                               "Booklet created successfully!\n\n" + message);
+    } else {
+        showError("Failed to create booklet: " + message);
+    }
+}
+
 void MainWindow::showError(const QString &message)
 {
     QMessageBox::critical(this, "Error", message);
@@ -6,9 +6,13 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QProgressDialog>
+#include <QFutureWatcher>
+#include "bookletjob.h"
 #include "pdfbookletcreator.h"
 #include "pdfpreviewwidget.h"
 
+class BookletClient;
+
 namespace Ui {
 class MainWindow;
 }
@@ -21,6 +25,9 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    void showEvent(QShowEvent *event) override;
+
 private slots:
     void on_browseButton_clicked();
     void on_createBookletButton_clicked();
@@ -30,6 +37,8 @@ private slots:
     void on_actionSaveAs_triggered();
     void on_actionExit_triggered();
     void on_actionAbout_triggered();
+    void startDependencyCheck();
+    void dependencyCheckFinished();
 
 private:
     Ui::MainWindow *ui;
@@ -38,9 +47,36 @@ private:
     QString inputFilePath;
     QString outputFilePath;
     
+    // Background dependency check; booklet creation stays disabled until
+    // it has found the tools
+    QFutureWatcher<PathConfig::DependencyStatus> *dependencyWatcher;
+    PathConfig::DependencyStatus dependencyStatus;
+    bool dependencyCheckStarted = false;
+    bool dependencyCheckDone = false;
+    
+    // Output menu: optional passes over the booklet, remembered across runs
+    QAction *dedupAction;
+    QAction *downsampleAction;
+    QAction *objectStreamsAction;
+    QAction *parallelCompressionAction;
+    QAction *linearizeAction;
+    void setupOutputMenu();
+    // The job the create button runs, from the paths and options chosen
+    BookletJob currentJob() const;
+    
+    // The job in flight: a daemon submission, while client is set, or a
+    // local run. The dialog only exists while a job does.
+    QProgressDialog *progressDialog = nullptr;
+    BookletClient *daemonClient = nullptr;
+    void showEta(qint64 remainingMs, const QString &stage);
+    // Lay the job out here, on the GUI thread
+    void createLocally(const BookletJob &job);
+    // Drop the daemon client and the progress dialog
+    void endJob();
+    
     void updateUI();
+    void reportResult(bool success, const QString &message);
     void showError(const QString &message);
-    bool checkDependencies();
 };
 
 #endif // MAINWINDOW_H
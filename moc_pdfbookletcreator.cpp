@@ -1,137 +0,0 @@
-/****************************************************************************
-** Meta object code from reading C++ file 'pdfbookletcreator.h'
-**
-** Created by: The Qt Meta Object Compiler version 69 (Qt 6.9.2)
-**
-** WARNING! All changes made in this file will be lost!
-*****************************************************************************/
-
-#include "pdfbookletcreator.h"
-#include <QtCore/qmetatype.h>
-
-#include <QtCore/qtmochelpers.h>
-
-#include <memory>
-
-
-#include <QtCore/qxptype_traits.h>
-#if !defined(Q_MOC_OUTPUT_REVISION)
-#error "The header file 'pdfbookletcreator.h' doesn't include <QObject>."
-#elif Q_MOC_OUTPUT_REVISION != 69
-#error "This file was generated using the moc from 6.9.2. It"
-#error "cannot be used with the include files from this version of Qt."
-#error "(The moc has changed too much.)"
-#endif
-
-#ifndef Q_CONSTINIT
-#define Q_CONSTINIT
-#endif
-
-QT_WARNING_PUSH
-QT_WARNING_DISABLE_DEPRECATED
-QT_WARNING_DISABLE_GCC("-Wuseless-cast")
-namespace {
-struct qt_meta_tag_ZN18QPDFBookletCreatorE_t {};
-} // unnamed namespace
-
-template <> constexpr inline auto QPDFBookletCreator::qt_create_metaobjectdata<qt_meta_tag_ZN18QPDFBookletCreatorE_t>()
-{
-    namespace QMC = QtMocConstants;
-    QtMocHelpers::StringRefStorage qt_stringData {
-        "QPDFBookletCreator",
-        "progressChanged",
-        "",
-        "progress",
-        "processingComplete",
-        "success",
-        "message"
-    };
-
-    QtMocHelpers::UintData qt_methods {
-        // Signal 'progressChanged'
-        QtMocHelpers::SignalData<void(int)>(1, 2, QMC::AccessPublic, QMetaType::Void, {{
-            { QMetaType::Int, 3 },
-        }}),
-        // Signal 'processingComplete'
-        QtMocHelpers::SignalData<void(bool, const QString &)>(4, 2, QMC::AccessPublic, QMetaType::Void, {{
-            { QMetaType::Bool, 5 }, { QMetaType::QString, 6 },
-        }}),
-    };
-    QtMocHelpers::UintData qt_properties {
-    };
-    QtMocHelpers::UintData qt_enums {
-    };
-    return QtMocHelpers::metaObjectData<QPDFBookletCreator, qt_meta_tag_ZN18QPDFBookletCreatorE_t>(QMC::MetaObjectFlag{}, qt_stringData,
-            qt_methods, qt_properties, qt_enums);
-}
-Q_CONSTINIT const QMetaObject QPDFBookletCreator::staticMetaObject = { {
-    QMetaObject::SuperData::link<QObject::staticMetaObject>(),
-    qt_staticMetaObjectStaticContent<qt_meta_tag_ZN18QPDFBookletCreatorE_t>.stringdata,
-    qt_staticMetaObjectStaticContent<qt_meta_tag_ZN18QPDFBookletCreatorE_t>.data,
-    qt_static_metacall,
-    nullptr,
-    qt_staticMetaObjectRelocatingContent<qt_meta_tag_ZN18QPDFBookletCreatorE_t>.metaTypes,
-    nullptr
-} };
-
-void QPDFBookletCreator::qt_static_metacall(QObject *_o, QMetaObject::Call _c, int _id, void **_a)
-{
-    auto *_t = static_cast<QPDFBookletCreator *>(_o);
-    if (_c == QMetaObject::InvokeMetaMethod) {
-        switch (_id) {
-        case 0: _t->progressChanged((*reinterpret_cast< std::add_pointer_t<int>>(_a[1]))); break;
-        case 1: _t->processingComplete((*reinterpret_cast< std::add_pointer_t<bool>>(_a[1])),(*reinterpret_cast< std::add_pointer_t<QString>>(_a[2]))); break;
-        default: ;
-        }
-    }
-    if (_c == QMetaObject::IndexOfMethod) {
-        if (QtMocHelpers::indexOfMethod<void (QPDFBookletCreator::*)(int )>(_a, &QPDFBookletCreator::progressChanged, 0))
-            return;
-        if (QtMocHelpers::indexOfMethod<void (QPDFBookletCreator::*)(bool , const QString & )>(_a, &QPDFBookletCreator::processingComplete, 1))
-            return;
-    }
-}
-
-const QMetaObject *QPDFBookletCreator::metaObject() const
-{
-    return QObject::d_ptr->metaObject ? QObject::d_ptr->dynamicMetaObject() : &staticMetaObject;
-}
-
-void *QPDFBookletCreator::qt_metacast(const char *_clname)
-{
-    if (!_clname) return nullptr;
-    if (!strcmp(_clname, qt_staticMetaObjectStaticContent<qt_meta_tag_ZN18QPDFBookletCreatorE_t>.strings))
-        return static_cast<void*>(this);
-    return QObject::qt_metacast(_clname);
-}
-
-int QPDFBookletCreator::qt_metacall(QMetaObject::Call _c, int _id, void **_a)
-{
-    _id = QObject::qt_metacall(_c, _id, _a);
-    if (_id < 0)
-        return _id;
-    if (_c == QMetaObject::InvokeMetaMethod) {
-        if (_id < 2)
-            qt_static_metacall(this, _c, _id, _a);
-        _id -= 2;
-    }
-    if (_c == QMetaObject::RegisterMethodArgumentMetaType) {
-        if (_id < 2)
-            *reinterpret_cast<QMetaType *>(_a[0]) = QMetaType();
-        _id -= 2;
-    }
-    return _id;
-}
-
-// SIGNAL 0
-void QPDFBookletCreator::progressChanged(int _t1)
-{
-    QMetaObject::activate<void>(this, &staticMetaObject, 0, nullptr, _t1);
-}
-
-// SIGNAL 1
-void QPDFBookletCreator::processingComplete(bool _t1, const QString & _t2)
-{
-    QMetaObject::activate<void>(this, &staticMetaObject, 1, nullptr, _t1, _t2);
-}
-QT_WARNING_POP
@@ -0,0 +1,85 @@
+#include "outputring.h"
+#include <QtGlobal>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(lcToolOutput, "booklet.tooloutput", QtInfoMsg)
+
+OutputRing::OutputRing(int capacity)
+    : m_buffer(qMax(capacity, 1), '\0')
+    , m_start(0)
+    , m_size(0)
+    , m_totalBytes(0)
+{
+}
+
+void OutputRing::append(const QByteArray &data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+    
+    const int capacity = m_buffer.size();
+    m_totalBytes += data.size();
+    
+    // Only the tail of an oversized chunk can survive
+    const char *source = data.constData();
+    int length = data.size();
+    if (length >= capacity) {
+        std::memcpy(m_buffer.data(), source + length - capacity, capacity);
+        m_start = 0;
+        m_size = capacity;
+        return;
+    }
+    
+    // Copy in at most two pieces around the end of the buffer
+    int end = (m_start + m_size) % capacity;
+    int firstPiece = qMin(length, capacity - end);
+    std::memcpy(m_buffer.data() + end, source, firstPiece);
+    std::memcpy(m_buffer.data(), source + firstPiece, length - firstPiece);
+    
+    // Drop the oldest bytes that were overwritten
+    int overflow = m_size + length - capacity;
+    if (overflow > 0) {
+        m_start = (m_start + overflow) % capacity;
+        m_size = capacity;
+    } else {
+        m_size += length;
+    }
+}
+
+void OutputRing::clear()
+{
+    m_start = 0;
+    m_size = 0;
+    m_totalBytes = 0;
+}
+
+QByteArray OutputRing::contents() const
+{
+    const int capacity = m_buffer.size();
+    int firstPiece = qMin(m_size, capacity - m_start);
+    QByteArray result;
+    result.reserve(m_size);
+    result.append(m_buffer.constData() + m_start, firstPiece);
+    result.append(m_buffer.constData(), m_size - firstPiece);
+    return result;
+}
+
+QString OutputRing::text() const
+{
+    QString decoded = QString::fromUtf8(contents());
+    if (droppedBytes() > 0) {
+        decoded.prepend(QString("[... %1 earlier bytes dropped ...]\n").arg(droppedBytes()));
+    }
+    return decoded;
+}
+
+int OutputRing::defaultCapacity()
+{
+    bool ok = false;
+    int kilobytes = qEnvironmentVariableIntValue("BOOKLET_TOOL_OUTPUT_KB", &ok);
+    if (ok && kilobytes > 0) {
+        return kilobytes * 1024;
+    }
+    return 16 * 1024;
+}
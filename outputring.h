@@ -0,0 +1,43 @@
+#ifndef OUTPUTRING_H
+#define OUTPUTRING_H
+
+#include <QByteArray>
+#include <QLoggingCategory>
+#include <QString>
+
+// Child process output is only logged on failure, or with
+// QT_LOGGING_RULES="booklet.tooloutput.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcToolOutput)
+
+// Fixed-size ring buffer keeping the last bytes written by a child process.
+// Output is kept as raw bytes and only decoded when text() is asked for, so
+// a chatty tool costs the same memory however much it prints.
+class OutputRing
+{
+public:
+    explicit OutputRing(int capacity = defaultCapacity());
+    
+    void append(const QByteArray &data);
+    void clear();
+    
+    bool isEmpty() const { return m_size == 0; }
+    // Retained bytes, oldest first
+    QByteArray contents() const;
+    // Retained bytes decoded as UTF-8, noting how much was dropped
+    QString text() const;
+    
+    // Bytes appended since the last clear, and how many of those were dropped
+    qint64 totalBytes() const { return m_totalBytes; }
+    qint64 droppedBytes() const { return m_totalBytes - m_size; }
+    
+    // Bytes kept per stream. Overridable with BOOKLET_TOOL_OUTPUT_KB.
+    static int defaultCapacity();
+
+private:
+    QByteArray m_buffer;
+    int m_start;
+    int m_size;
+    qint64 m_totalBytes;
+};
+
+#endif // OUTPUTRING_H
@@ -0,0 +1,83 @@
+#include "pathconfig.h"
+#include <QDir>
+
+QString PathConfig::qpdfPath("/opt/homebrew/bin/qpdf");
+QString PathConfig::pdfjamPath("/opt/homebrew/bin/pdfjam");
+QString PathConfig::pdflatexPath;
+
+PathConfig::DependencyStatus PathConfig::dependencyStatus()
+{
+    DependencyStatus status;
+    status.qpdfPath = findExecutable("qpdf");
+    status.qpdf = probeTool("qpdf", status.qpdfPath, status.missingDeps);
+    status.pdfjamPath = findExecutable("pdfjam");
+    status.pdfjam = probeTool("pdfjam (part of texlive)", status.pdfjamPath, status.missingDeps);
+    
+    status.pdflatexPath = findPdflatex();
+    status.pdflatex = !status.pdflatexPath.isEmpty();
+    if (!status.pdflatex) {
+        status.missingDeps += "- pdflatex (part of texlive)\n";
+    }
+    return status;
+}
+
+void PathConfig::apply(const DependencyStatus &status)
+{
+    qpdfPath = status.qpdfPath;
+    pdfjamPath = status.pdfjamPath;
+    pdflatexPath = status.pdflatexPath;
+}
+
+QString PathConfig::findPdflatex(const std::function<bool(const QString &)> &probe)
+{
+    QStringList candidates;
+    QString inPath = findExecutable("pdflatex");
+    if (inPath != "pdflatex") {
+        candidates << inPath;
+    }
+    for (const QString &dir : searchDirectories()) {
+        QString path = dir + "/pdflatex";
+        if (!candidates.contains(path) && QFile::exists(path)) {
+            candidates << path;
+        }
+    }
+    candidates << "pdflatex";  // fallback to PATH
+    
+    for (const QString &candidate : std::as_const(candidates)) {
+        bool works;
+        if (probe) {
+            works = probe(candidate);
+        } else {
+            ToolProcess latexCheck;
+            latexCheck.start(candidate, QStringList() << "--version");
+            works = latexCheck.waitForFinished() && latexCheck.exitCode() == 0;
+        }
+        if (works) {
+            qDebug() << "Found pdflatex at:" << candidate;
+            return candidate;
+        }
+    }
+    return QString();
+}
+
+QStringList PathConfig::searchDirectories()
+{
+    QStringList dirs = {
+        "/opt/homebrew/bin",
+        "/usr/local/bin",
+        "/usr/bin",
+        "/Library/TeX/texbin"       // MacTeX
+    };
+    
+    // TeX Live installs into /usr/local/texlive/<year>/bin/<platform>;
+    // newest year first
+    QDir texlive("/usr/local/texlive");
+    const QStringList years = texlive.entryList(QStringList() << "20*", QDir::Dirs, QDir::Name | QDir::Reversed);
+    for (const QString &year : years) {
+        QDir bin(texlive.filePath(year + "/bin"));
+        for (const QString &platform : bin.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            dirs << bin.filePath(platform);
+        }
+    }
+    return dirs;
+}
@@ -1,17 +1,24 @@
 #ifndef PATHCONFIG_H
 #define PATHCONFIG_H
 
+#include "toolprocess.h"
 #include <QString>
-#include <QProcess>
+#include <QStringList>
 #include <QFile>
 #include <QDebug>
+#include <functional>
 
 class PathConfig
 {
 public:
     static QString qpdfPath;
     static QString pdfjamPath;
+    // Empty until a working pdflatex has been found
+    static QString pdflatexPath;
     
+    // Locate every tool and set the paths above. The paths are plain
+    // statics: threaded callers run dependencyStatus() anywhere and apply()
+    // its result on the thread that starts the jobs.
     static void initialize()
     {
         // Find qpdf
@@ -21,61 +28,83 @@ public:
         // Find pdfjam
         pdfjamPath = findExecutable("pdfjam");
         qDebug() << "Using pdfjam path:" << pdfjamPath;
+        
+        pdflatexPath = findPdflatex();
+        qDebug() << "Using pdflatex path:" << pdflatexPath;
     }
     
-    static bool checkDependencies(QString &missingDeps)
+    // Which external tools were found and answer --version, so features can
+    // be disabled one by one instead of all at once
+    struct DependencyStatus
     {
-        bool allPresent = true;
+        QString qpdfPath;
+        QString pdfjamPath;
+        QString pdflatexPath;
+        bool qpdf = false;
+        bool pdfjam = false;
+        bool pdflatex = false;
+        QString missingDeps;
         
-        // Check qpdf
-        if (qpdfPath.isEmpty()) {
-            allPresent = false;
-            missingDeps += "- qpdf\n";
-        } else {
-            // Test if it works
-            QProcess testProcess;
-            testProcess.start(qpdfPath, QStringList() << "--version");
-            if (!testProcess.waitForFinished() || testProcess.exitCode() != 0) {
-                allPresent = false;
-                missingDeps += "- qpdf (installed but not working)\n";
-            }
+        // Booklet and 2-up layouts run qpdf and pdflatex; pdfjam is optional
+        bool canLayOut() const { return qpdf && pdflatex; }
+    };
+    
+    // Locate and probe every tool without touching the statics above, so it
+    // can run on any thread. This spawns and waits for several child
+    // processes, so interactive callers should run it off the GUI thread.
+    static DependencyStatus dependencyStatus();
+    
+    // Take the paths of a finished dependencyStatus()
+    static void apply(const DependencyStatus &status);
+    
+    // Locate pdflatex: PATH first, then the usual install directories,
+    // including the TeX Live and MacTeX ones a GUI app started from the
+    // Finder does not have in PATH. Candidates are tried with probe
+    // (by default, running "--version"); returns "" if none works.
+    static QString findPdflatex(const std::function<bool(const QString &)> &probe = nullptr);
+    
+    static bool checkDependencies(QString &missingDeps)
+    {
+        bool qpdfPresent = probeTool("qpdf", qpdfPath, missingDeps);
+        bool pdfjamPresent = probeTool("pdfjam (part of texlive)", pdfjamPath, missingDeps);
+        return qpdfPresent && pdfjamPresent;
+    }
+    
+private:
+    // Check that the tool at path runs; on failure add a "- label" line to
+    // missingDeps
+    static bool probeTool(const QString &label, const QString &path, QString &missingDeps)
+    {
+        if (path.isEmpty()) {
+            missingDeps += "- " + label + "\n";
+            return false;
         }
         
-        // Check pdfjam
-        if (pdfjamPath.isEmpty()) {
-            allPresent = false;
-            missingDeps += "- pdfjam (part of texlive)\n";
-        } else {
-            // Test if it works
-            QProcess testProcess;
-            testProcess.start(pdfjamPath, QStringList() << "--version");
-            if (!testProcess.waitForFinished() || testProcess.exitCode() != 0) {
-                allPresent = false;
-                missingDeps += "- pdfjam (installed but not working)\n";
-            }
+        // Test if it works
+        ToolProcess testProcess;
+        testProcess.start(path, QStringList() << "--version");
+        if (!testProcess.waitForFinished() || testProcess.exitCode() != 0) {
+            missingDeps += "- " + label + " (installed but not working)\n";
+            return false;
         }
-        
-        return allPresent;
+        return true;
     }
     
-private:
+    // Directories searched after PATH, most likely first
+    static QStringList searchDirectories();
+    
     static QString findExecutable(const QString &name)
     {
         // Try using 'which' command
-        QProcess whichProcess;
+        ToolProcess whichProcess;
         whichProcess.start("which", QStringList() << name);
         if (whichProcess.waitForFinished() && whichProcess.exitCode() == 0) {
             return QString(whichProcess.readAllStandardOutput()).trimmed();
         }
         
         // Try common locations
-        QStringList commonPaths = {
-            "/opt/homebrew/bin/" + name,
-            "/usr/local/bin/" + name,
-            "/usr/bin/" + name
-        };
-        
-        for (const QString &path : commonPaths) {
+        for (const QString &dir : searchDirectories()) {
+            QString path = dir + "/" + name;
             if (QFile::exists(path)) {
                 return path;
             }
@@ -86,8 +115,4 @@ private:
     }
 };
 
-// Initialize static members
-//extern QString PathConfig::qpdfPath;
-//extern QString PathConfig::pdfjamPath;
-
 #endif // PATHCONFIG_H
@@ -1,10 +1,28 @@
 #include "pdfbookletcreator.h"
+#include "scratchdir.h"
+#include "pdfoptimizer.h"
+#include "stagetracer.h"
+#include "stagewatchdog.h"
+#include "progressestimator.h"
+#include "rendererloader.h"
+#include "jobjournal.h"
+#include "taskscheduler.h"
+#include "processgovernor.h"
+#include "toolprocess.h"
+#include <QElapsedTimer>
+#include <sys/resource.h>
+#include <cstring>
 #include <QDebug>
-#include <QProcess>
-#include <QTemporaryDir>
 #include <QFileInfo>
 #include <QDir>
 #include <QImageReader>
+#include <QFile>
+#include <QTextStream>
+#include <QCryptographicHash>
+#include <QProcessEnvironment>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 QPDFBookletCreator::QPDFBookletCreator(QObject *parent) : QObject(parent)
 {
@@ -16,6 +34,8 @@ QPDFBookletCreator::~QPDFBookletCreator()
 
 bool QPDFBookletCreator::createBooklet(const QString &inputPath, const QString &outputPath, bool startFromBeginning)
 {
+    JobScope job(this);
+    
     qDebug() << "=== Starting booklet creation ===";
     qDebug() << "Input path:" << inputPath;
     qDebug() << "Output path:" << outputPath;
@@ -26,7 +46,7 @@ bool QPDFBookletCreator::createBooklet(const QString &inputPath, const QString &
     if (!inputInfo.exists()) {
         QString error = QString("Input file does not exist: %1").arg(inputPath);
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
@@ -38,27 +58,118 @@ bool QPDFBookletCreator::createBooklet(const QString &inputPath, const QString &
         if (!outputDir.mkpath(".")) {
             QString error = QString("Cannot create output directory: %1").arg(outputDir.absolutePath());
             qDebug() << error;
-            emit processingComplete(false, error);
+            completeJob(false, error);
             return false;
         }
         qDebug() << "Created output directory:" << outputDir.absolutePath();
     }
     
-    try {
-        return arrangePages(inputPath, outputPath, startFromBeginning);
-    } catch (std::exception &e) {
-        QString error = QString("Exception: %1").arg(e.what());
-        qDebug() << error;
-        emit processingComplete(false, error);
+    bool success = false;
+    {
+        TraceSpan jobSpan("createBooklet", &m_report, "job");
+        jobSpan.setArg("input", inputPath);
+        jobSpan.addFileRead(inputPath);
+        
+        try {
+            success = arrangePages(inputPath, outputPath, startFromBeginning);
+        } catch (std::exception &e) {
+            QString error = QString("Exception: %1").arg(e.what());
+            qDebug() << error;
+            completeJob(false, error);
+        } catch (...) {
+            qDebug() << "Unknown exception occurred";
+            completeJob(false, "Unknown error occurred");
+        }
+        
+        if (success) {
+            jobSpan.addFileWritten(outputPath);
+        }
+    }
+    
+    return success;
+}
+
+bool QPDFBookletCreator::createBooklet(QByteArrayView input, QIODevice *output, bool startFromBeginning)
+{
+    return runInMemory(input, output, [this, startFromBeginning](const QString &inputPath, const QString &outputPath) {
+        return createBooklet(inputPath, outputPath, startFromBeginning);
+    });
+}
+
+bool QPDFBookletCreator::create2UpLayout(QByteArrayView input, QIODevice *output)
+{
+    return runInMemory(input, output, [this](const QString &inputPath, const QString &outputPath) {
+        return create2UpLayout(inputPath, outputPath);
+    });
+}
+
+bool QPDFBookletCreator::createSequential2Up(QByteArrayView input, QIODevice *output)
+{
+    return runInMemory(input, output, [this](const QString &inputPath, const QString &outputPath) {
+        return createSequential2Up(inputPath, outputPath);
+    });
+}
+
+bool QPDFBookletCreator::runInMemory(QByteArrayView input, QIODevice *output,
+                                     const std::function<bool(const QString &, const QString &)> &layout)
+{
+    JobScope job(this);
+    
+    if (!output || !output->isWritable()) {
+        completeJob(false, "The output device is not open for writing");
         return false;
-    } catch (...) {
-        qDebug() << "Unknown exception occurred";
-        emit processingComplete(false, "Unknown error occurred");
+    }
+    
+    ScratchDir scratch(input.size() * 3, &m_report);
+    if (!scratch.isValid()) {
+        completeJob(false, "Failed to create a scratch directory for the input");
         return false;
     }
+    QString inputPath = scratch.filePath("input.pdf");
+    QString outputPath = scratch.filePath("output.pdf");
+    
+    QFile inputFile(inputPath);
+    if (!inputFile.open(QIODevice::WriteOnly)
+        || inputFile.write(input.data(), input.size()) != input.size()) {
+        completeJob(false, "Failed to write the input to " + inputPath);
+        return false;
+    }
+    inputFile.close();
+    
+    // Parts published next to a scratch output would vanish with it
+    bool streaming = m_streamingOutput;
+    m_streamingOutput = false;
+    bool success = layout(inputPath, outputPath);
+    m_streamingOutput = streaming;
+    if (!success) {
+        return false;
+    }
+    
+    // Copied in slices, so a large result is never held twice
+    QString error;
+    QFile result(outputPath);
+    if (!result.open(QIODevice::ReadOnly)) {
+        error = "Failed to read the result from " + outputPath;
+    }
+    QByteArray chunk(64 * 1024, Qt::Uninitialized);
+    while (error.isEmpty() && !result.atEnd()) {
+        qint64 length = result.read(chunk.data(), chunk.size());
+        if (length < 0 || output->write(chunk.constData(), length) != length) {
+            error = "Failed to write the result: " + output->errorString();
+        }
+    }
+    
+    if (!error.isEmpty()) {
+        qDebug() << error;
+        // The layout already reported success, but the job as a whole failed
+        m_jobSucceeded = false;
+        m_jobMessage = error;
+        return false;
+    }
+    return true;
 }
 
-void QPDFBookletCreator::debugProcess(QProcess &process, const QString &command, const QStringList &args)
+void QPDFBookletCreator::debugProcess(ToolProcess &process, const QString &command, const QStringList &args)
 {
     qDebug() << "--- Process Debug Info ---";
     qDebug() << "Command:" << command;
@@ -68,51 +179,218 @@ void QPDFBookletCreator::debugProcess(QProcess &process, const QString &command,
     qDebug() << "Exit code:" << process.exitCode();
     qDebug() << "Exit status:" << process.exitStatus();
     
-    QString stdout = process.readAllStandardOutput();
-    QString stderr = process.readAllStandardError();
+    // runTool has already drained the pipes; pick up anything left over
+    m_toolStdout.append(process.readAllStandardOutput());
+    m_toolStderr.append(process.readAllStandardError());
     
-    if (!stdout.isEmpty()) {
-        qDebug() << "STDOUT:" << stdout;
+    if (!m_toolStdout.isEmpty()) {
+        qDebug() << "STDOUT:" << m_toolStdout.text();
     }
-    if (!stderr.isEmpty()) {
-        qDebug() << "STDERR:" << stderr;
+    if (!m_toolStderr.isEmpty()) {
+        qDebug() << "STDERR:" << m_toolStderr.text();
     }
     qDebug() << "--- End Process Debug ---";
 }
 
+QPDFBookletCreator::JobScope::JobScope(QPDFBookletCreator *creator) : m_creator(creator)
+{
+    if (m_creator->m_jobDepth++ == 0) {
+        m_creator->m_report = ResourceReport();
+        m_creator->m_report.start();
+        m_creator->m_jobCompleted = false;
+        m_creator->m_jobSucceeded = false;
+        m_creator->m_jobMessage.clear();
+        m_creator->m_progress.start();
+        m_creator->m_lastProgress = -1;
+        m_creator->m_progressTimer.invalidate();
+    }
+}
+
+QPDFBookletCreator::JobScope::~JobScope()
+{
+    if (--m_creator->m_jobDepth == 0) {
+        m_creator->finishJob();
+    }
+}
+
+void QPDFBookletCreator::completeJob(bool success, const QString &message)
+{
+    // The first result of a job wins; it is emitted once the outermost
+    // entry point returns and every scratch directory has been removed
+    if (m_jobCompleted) {
+        return;
+    }
+    m_jobCompleted = true;
+    m_jobSucceeded = success;
+    m_jobMessage = message;
+    
+    if (m_jobDepth == 0) {
+        finishJob();
+    }
+}
+
+void QPDFBookletCreator::finishJob()
+{
+    if (!m_jobCompleted) {
+        m_jobSucceeded = false;
+        m_jobMessage = "Unknown error occurred";
+    }
+    
+    m_report.finish(m_jobSucceeded);
+    QJsonObject report = m_report.toJson();
+    qDebug() << "Job resource report:" << QJsonDocument(report).toJson(QJsonDocument::Compact);
+    
+    QString logError;
+    if (!m_report.appendToLog(logError)) {
+        qDebug() << logError;
+    }
+    
+    QString traceError;
+    if (!StageTracer::instance().flush(traceError)) {
+        qDebug() << traceError;
+    }
+    
+    // What the job's runs taught the watchdog and the governor
+    StageWatchdog::saveHistory();
+    ProcessGovernor::saveEstimates();
+    
+    if (m_jobSucceeded) {
+        m_progress.finish();
+        logProgress();
+    }
+    
+    emit processingComplete(m_jobSucceeded, m_jobMessage, report);
+}
+
+bool QPDFBookletCreator::runTool(ToolProcess &process, const QString &program,
+                                 const QStringList &args, const QString &stage,
+                                 int pages, qint64 inputBytes)
+{
+    QString tool = QFileInfo(program).fileName();
+    
+    // Wait for a slot before any deadline starts counting
+    std::unique_ptr<ProcessGovernor::Ticket> ticket =
+        ProcessGovernor::instance().acquire(tool, m_governorJob ? m_governorJob : quintptr(this));
+    
+    StageWatchdog watchdog(stage, pages, inputBytes);
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    m_toolStdout.clear();
+    m_toolStderr.clear();
+    m_toolFailure.clear();
+    
+    process.start(program, args);
+    if (!process.waitForStarted(qMin(watchdog.deadlineMs(), 30000))) {
+        return false;
+    }
+    
+    // Wait in short slices so the child's peak RSS and CPU progress can be
+    // sampled
+    qint64 pid = process.processId();
+    watchdog.start(pid);
+    m_progress.beginRun(stage, pages, inputBytes);
+    qint64 peakRssKb = 0;
+    double sampledUserCpuMs = 0.0;
+    double sampledSystemCpuMs = 0.0;
+    bool finished = false;
+    while (!finished) {
+        bool exited = process.state() == QProcess::NotRunning || process.waitForFinished(100);
+        // Keep only a bounded tail of the output instead of letting
+        // the process buffer all of it, looking for progress markers on the way
+        QByteArray output = process.readAllStandardOutput();
+        m_toolStdout.append(output);
+        m_progress.scanOutput(output);
+        m_toolStderr.append(process.readAllStandardError());
+        logProgress();
+        if (exited) {
+            finished = true;
+            break;
+        }
+        peakRssKb = qMax(peakRssKb, ResourceReport::processPeakRssKb(pid));
+        ResourceReport::processCpuMs(pid, sampledUserCpuMs, sampledSystemCpuMs);
+        qint64 outputBytes = m_toolStdout.totalBytes() + m_toolStderr.totalBytes();
+        if (watchdog.check(outputBytes) != StageWatchdog::Running) {
+            m_toolFailure = watchdog.reason();
+            qDebug() << "Watchdog:" << m_toolFailure;
+            break;
+        }
+    }
+    
+    if (!finished) {
+        // Reap the child so its CPU time is still accounted
+        process.kill();
+        process.waitForFinished(1000);
+        m_toolStdout.append(process.readAllStandardOutput());
+        m_toolStderr.append(process.readAllStandardError());
+    }
+    
+    // A child started through the spawn helper comes with its own usage
+    // from wait4. QProcess reaps its children itself, so without the helper
+    // only the last sample taken while the child ran is known: it misses
+    // up to one wait slice, and all of a child that exits within the first.
+    // RUSAGE_CHILDREN is no substitute, since it also grows with every
+    // child other threads reap.
+    double userCpuMs = sampledUserCpuMs;
+    double systemCpuMs = sampledSystemCpuMs;
+    bool ownUsage = process.hasUsage();
+    if (ownUsage) {
+        struct rusage usage = process.usage();
+        userCpuMs = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+        systemCpuMs = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+        peakRssKb = qMax(peakRssKb, ResourceReport::maxRssKb(usage));
+    }
+    
+    m_report.addToolRun(tool, timer.nsecsElapsed() / 1e6, userCpuMs, systemCpuMs, peakRssKb,
+                        !ownUsage);
+    ticket->recordPeakRss(peakRssKb);
+    
+    // Only successful runs say how long the stage takes; qpdf exits with 3
+    // when it succeeded with warnings
+    int exitCode = process.exitCode();
+    if (finished && process.exitStatus() == QProcess::NormalExit
+        && (exitCode == 0 || (exitCode == 3 && tool.startsWith("qpdf")))) {
+        watchdog.recordCompletion(timer.elapsed());
+    }
+    m_progress.finishRun();
+    logProgress();
+    return finished;
+}
+
+QString QPDFBookletCreator::toolError(const ToolProcess &process) const
+{
+    return m_toolFailure.isEmpty() ? process.errorString() : m_toolFailure;
+}
+
 bool QPDFBookletCreator::arrangePages(const QString &inputPath, const QString &outputPath, bool startFromBeginning)
 {
     qDebug() << "=== Arranging pages ===";
     
+    TraceSpan preflightSpan("preflight", &m_report);
+    preflightSpan.addFileRead(inputPath);
+    
     // Check if required tools exist
     qDebug() << "Checking for required tools:";
     qDebug() << "qpdf path:" << PathConfig::qpdfPath;
-    qDebug() << "pdfjam path:" << PathConfig::pdfjamPath;
     
     // Test if qpdf exists and is executable
     QFileInfo qpdfInfo(PathConfig::qpdfPath);
     if (!qpdfInfo.exists() || !qpdfInfo.isExecutable()) {
         QString error = QString("qpdf not found or not executable at: %1").arg(PathConfig::qpdfPath);
         qDebug() << error;
-        emit processingComplete(false, error);
-        return false;
-    }
-    
-    // Test if pdfjam exists and is executable
-    QFileInfo pdfjamInfo(PathConfig::pdfjamPath);
-    if (!pdfjamInfo.exists() || !pdfjamInfo.isExecutable()) {
-        QString error = QString("pdfjam not found or not executable at: %1").arg(PathConfig::pdfjamPath);
-        qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    // Create a temporary directory for working files
-    QTemporaryDir tempDir;
+    // Create a scratch directory for working files; padding and reordering
+    // each keep roughly one copy of the input
+    QFileInfo inputInfo(inputPath);
+    ScratchDir tempDir(durableScratch("arrange"), inputInfo.size() * 3, &m_report);
     if (!tempDir.isValid()) {
         QString error = "Could not create temporary directory";
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
@@ -120,18 +398,16 @@ bool QPDFBookletCreator::arrangePages(const QString &inputPath, const QString &o
     
     // Get PDF page count using qpdf
     qDebug() << "Getting page count...";
-    QProcess process;
+    ToolProcess process;
     QStringList pageCountArgs;
     pageCountArgs << "--show-npages" << inputPath;
     
     qDebug() << "Running qpdf to get page count...";
-    process.start(PathConfig::qpdfPath, pageCountArgs);
-    
-    if (!process.waitForFinished(30000)) { // 30 second timeout
+    if (!runTool(process, PathConfig::qpdfPath, pageCountArgs, "pagecount", 0, inputInfo.size())) {
         debugProcess(process, PathConfig::qpdfPath, pageCountArgs);
-        QString error = "Failed to get page count (timeout or process error): " + process.errorString();
+        QString error = "Failed to get page count (timeout or process error): " + toolError(process);
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
@@ -140,31 +416,29 @@ bool QPDFBookletCreator::arrangePages(const QString &inputPath, const QString &o
         debugProcess(process, PathConfig::qpdfPath, pageCountArgs);
         QString error = QString("qpdf failed with exit code %1").arg(exitCode);
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    QString pageCountOutput = process.readAllStandardOutput().trimmed();
+    QString pageCountOutput = QString::fromUtf8(m_toolStdout.contents()).trimmed();
     qDebug() << "Page count output:" << pageCountOutput;
     
-    // Debug the process after we've captured the output
-    qDebug() << "--- Process Debug Info ---";
-    qDebug() << "Command:" << PathConfig::qpdfPath;
-    qDebug() << "Arguments:" << pageCountArgs.join(" ");
-    qDebug() << "Exit code:" << process.exitCode();
-    qDebug() << "Exit status:" << process.exitStatus();
-    qDebug() << "--- End Process Debug ---";
+    if (lcToolOutput().isDebugEnabled()) {
+        debugProcess(process, PathConfig::qpdfPath, pageCountArgs);
+    }
     
     bool ok;
     int pageCount = pageCountOutput.toInt(&ok);
     if (!ok || pageCount <= 0) {
         QString error = QString("Invalid page count: '%1'").arg(pageCountOutput);
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
     qDebug() << "PDF has" << pageCount << "pages";
+    preflightSpan.setArg("pages", pageCount);
+    preflightSpan.finish();
     
     // Calculate pages needed for the booklet
     int sheetsNeeded = (pageCount + 3) / 4; // Round up division
@@ -173,108 +447,35 @@ bool QPDFBookletCreator::arrangePages(const QString &inputPath, const QString &o
     qDebug() << "Sheets needed:" << sheetsNeeded;
     qDebug() << "Total pages needed:" << totalPages;
     
-    // If we need blank pages, create a PDF with blank pages
-    QString paddedPdfPath = inputPath;
+    // Plan the rest of the job now that its size is known: padding and
+    // reordering here, then create4UpFor2Booklets puts each two-page side
+    // twice on a 2x2 sheet
     if (pageCount < totalPages) {
-        int blankPagesNeeded = totalPages - pageCount;
-        qDebug() << "Need to add" << blankPagesNeeded << "blank pages";
-        
-        QString blankPdf = tempDir.filePath("blank.pdf");
-        qDebug() << "Creating blank PDF at:" << blankPdf;
-        
-        // Create a blank PDF using qpdf
-        QProcess blankProcess;
-        QStringList blankArgs;
-        blankArgs << "--empty" << "--pages" << "." << QString::number(blankPagesNeeded) << "--" << blankPdf;
-        
-        qDebug() << "Creating blank pages...";
-        blankProcess.start(PathConfig::qpdfPath, blankArgs);
-        if (!blankProcess.waitForFinished(30000)) {
-            debugProcess(blankProcess, PathConfig::qpdfPath, blankArgs);
-            QString error = "Failed to create blank pages: " + blankProcess.errorString();
-            qDebug() << error;
-            emit processingComplete(false, error);
-            return false;
-        }
-        
-        debugProcess(blankProcess, PathConfig::qpdfPath, blankArgs);
-        
-        if (blankProcess.exitCode() != 0) {
-            QString error = QString("Failed to create blank pages, exit code: %1").arg(blankProcess.exitCode());
-            qDebug() << error;
-            emit processingComplete(false, error);
-            return false;
-        }
-        
-        // Check if blank PDF was created
-        QFileInfo blankInfo(blankPdf);
-        if (!blankInfo.exists()) {
-            QString error = "Blank PDF was not created at expected location: " + blankPdf;
-            qDebug() << error;
-            emit processingComplete(false, error);
-            return false;
-        }
-        qDebug() << "Blank PDF created successfully, size:" << blankInfo.size() << "bytes";
-        
-        // Concatenate original PDF with blank pages
-        paddedPdfPath = tempDir.filePath("padded.pdf");
-        qDebug() << "Creating padded PDF at:" << paddedPdfPath;
-        
-        QProcess catProcess;
-        QStringList catArgs;
-        catArgs << "--empty" << "--pages" << inputPath << "1-z" << blankPdf << "1-z" << "--" << paddedPdfPath;
-        
-        qDebug() << "Concatenating PDFs...";
-        catProcess.start(PathConfig::qpdfPath, catArgs);
-        if (!catProcess.waitForFinished(30000)) {
-            debugProcess(catProcess, PathConfig::qpdfPath, catArgs);
-            QString error = "Failed to add blank pages: " + catProcess.errorString();
-            qDebug() << error;
-            emit processingComplete(false, error);
-            return false;
-        }
-        
-        debugProcess(catProcess, PathConfig::qpdfPath, catArgs);
-        
-        if (catProcess.exitCode() != 0) {
-            QString error = QString("Failed to concatenate PDFs, exit code: %1").arg(catProcess.exitCode());
-            qDebug() << error;
-            emit processingComplete(false, error);
-            return false;
-        }
-        
-        // Check if padded PDF was created
-        QFileInfo paddedInfo(paddedPdfPath);
-        if (!paddedInfo.exists()) {
-            QString error = "Padded PDF was not created at expected location: " + paddedPdfPath;
-            qDebug() << error;
-            emit processingComplete(false, error);
+        m_progress.planStage("padding", totalPages - pageCount, 0);
+        m_progress.planStage("concat", totalPages, inputInfo.size());
+    }
+    m_progress.planStage("reorder", totalPages, inputInfo.size());
+    planLayout(totalPages * 2, SheetGrid{2, 2, false}, inputInfo.size());
+    logProgress();
+    
+    // If we need blank pages, create a PDF with blank pages, unless an
+    // interrupted attempt already did
+    QString paddedPdfPath = inputPath;
+    QString resumedPadding = pageCount < totalPages ? resumeArtifact("concat") : QString();
+    if (!resumedPadding.isEmpty()) {
+        m_progress.dropStage("padding");
+        paddedPdfPath = resumedPadding;
+        pageCount = totalPages;
+    } else if (pageCount < totalPages) {
+        if (!padPages(inputPath, pageCount, totalPages, tempDir.path(), paddedPdfPath)) {
             return false;
         }
-        qDebug() << "Padded PDF created successfully, size:" << paddedInfo.size() << "bytes";
-        
         pageCount = totalPages;
     }
     
     // Calculate page order for booklet
-    QList<int> pageOrder;
     qDebug() << "Calculating page order...";
-    
-    for (int sheet = 0; sheet < sheetsNeeded; sheet++) {
-        if (startFromBeginning) {
-            // Standard booklet ordering (first page is cover)
-            pageOrder.append(totalPages - sheet * 2);
-            pageOrder.append(sheet * 2 + 1);
-            pageOrder.append(sheet * 2 + 2);
-            pageOrder.append(totalPages - sheet * 2 - 1);
-        } else {
-            // Reverse ordering (last page is cover)
-            pageOrder.append(sheet * 2 + 1);
-            pageOrder.append(totalPages - sheet * 2);
-            pageOrder.append(totalPages - sheet * 2 - 1);
-            pageOrder.append(sheet * 2 + 2);
-        }
-    }
+    QList<int> pageOrder = bookletPageOrder(totalPages, startFromBeginning);
     
     qDebug() << "Page order:" << pageOrder;
     
@@ -282,6 +483,94 @@ bool QPDFBookletCreator::arrangePages(const QString &inputPath, const QString &o
     return createCombinedPage(paddedPdfPath, outputPath, pageOrder);
 }
 
+bool QPDFBookletCreator::padPages(const QString &inputPath, int pageCount, int totalPages,
+                                  const QString &workDir, QString &paddedPdfPath)
+{
+    TraceSpan paddingSpan("padding", &m_report);
+    int blankPagesNeeded = totalPages - pageCount;
+    qDebug() << "Need to add" << blankPagesNeeded << "blank pages";
+    
+    QString blankPdf = QDir(workDir).filePath("blank.pdf");
+    qDebug() << "Creating blank PDF at:" << blankPdf;
+    
+    // Create a blank PDF using qpdf
+    ToolProcess blankProcess;
+    QStringList blankArgs;
+    blankArgs << "--progress" << "--empty" << "--pages" << "." << QString::number(blankPagesNeeded) << "--" << blankPdf;
+    
+    qDebug() << "Creating blank pages...";
+    if (!runTool(blankProcess, PathConfig::qpdfPath, blankArgs, "padding", blankPagesNeeded)) {
+        debugProcess(blankProcess, PathConfig::qpdfPath, blankArgs);
+        QString error = "Failed to create blank pages: " + toolError(blankProcess);
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
+    
+    if (lcToolOutput().isDebugEnabled()) {
+        debugProcess(blankProcess, PathConfig::qpdfPath, blankArgs);
+    }
+    
+    if (blankProcess.exitCode() != 0) {
+        QString error = QString("Failed to create blank pages, exit code: %1").arg(blankProcess.exitCode());
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
+    
+    // Check if blank PDF was created
+    QFileInfo blankInfo(blankPdf);
+    if (!blankInfo.exists()) {
+        QString error = "Blank PDF was not created at expected location: " + blankPdf;
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
+    qDebug() << "Blank PDF created successfully, size:" << blankInfo.size() << "bytes";
+    
+    // Concatenate original PDF with blank pages
+    paddedPdfPath = QDir(workDir).filePath("padded.pdf");
+    qDebug() << "Creating padded PDF at:" << paddedPdfPath;
+    
+    ToolProcess catProcess;
+    QStringList catArgs;
+    catArgs << "--progress" << "--empty" << "--pages" << inputPath << "1-z" << blankPdf << "1-z" << "--" << paddedPdfPath;
+    
+    qDebug() << "Concatenating PDFs...";
+    if (!runTool(catProcess, PathConfig::qpdfPath, catArgs, "concat", totalPages, QFileInfo(inputPath).size())) {
+        debugProcess(catProcess, PathConfig::qpdfPath, catArgs);
+        QString error = "Failed to add blank pages: " + toolError(catProcess);
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
+    
+    if (lcToolOutput().isDebugEnabled()) {
+        debugProcess(catProcess, PathConfig::qpdfPath, catArgs);
+    }
+    
+    if (catProcess.exitCode() != 0) {
+        QString error = QString("Failed to concatenate PDFs, exit code: %1").arg(catProcess.exitCode());
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
+    
+    // Check if padded PDF was created
+    QFileInfo paddedInfo(paddedPdfPath);
+    if (!paddedInfo.exists()) {
+        QString error = "Padded PDF was not created at expected location: " + paddedPdfPath;
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
+    qDebug() << "Padded PDF created successfully, size:" << paddedInfo.size() << "bytes";
+    paddingSpan.addFileRead(inputPath);
+    paddingSpan.addFileWritten(paddedPdfPath);
+    checkpoint("concat", paddedPdfPath);
+    return true;
+}
+
 bool QPDFBookletCreator::createCombinedPage(const QString &inputPath, const QString &outputPath,
                                         const QList<int> &pageOrder)
 {
@@ -289,54 +578,75 @@ bool QPDFBookletCreator::createCombinedPage(const QString &inputPath, const QStr
     qDebug() << "Input path:" << inputPath;
     qDebug() << "Output path:" << outputPath;
     
-    QTemporaryDir tempDir;
+    ScratchDir tempDir(durableScratch("reorder"), QFileInfo(inputPath).size(), &m_report);
     if (!tempDir.isValid()) {
         QString error = "Could not create temporary directory for combined pages";
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
     qDebug() << "Temp directory for combined pages:" << tempDir.path();
     
-    // First, extract the pages in the right order into a single reordered PDF
-    QString reorderedPdf = tempDir.filePath("reordered.pdf");
+    // First, extract the pages in the right order into a single reordered PDF,
+    // unless an interrupted attempt already did
+    QString reorderedPdf = resumeArtifact("reorder");
+    if (reorderedPdf.isEmpty() && !reorderPages(inputPath, pageOrder, tempDir.path(), reorderedPdf)) {
+        return false;
+    }
+    
+    // Create 4-up layout for 2 identical booklets from 1 A4 sheet, using
+    // the booklet-ordered pages
+    qDebug() << "Creating 4-up layout for 2 identical booklets...";
+    return create4UpFor2Booklets(reorderedPdf, outputPath);
+}
+
+bool QPDFBookletCreator::reorderPages(const QString &inputPath, const QList<int> &pageOrder,
+                                      const QString &workDir, QString &reorderedPdf)
+{
+    reorderedPdf = QDir(workDir).filePath("reordered.pdf");
     qDebug() << "Reordered PDF path:" << reorderedPdf;
     
-    QStringList pageArgs;
-    pageArgs << "--empty" << "--pages";
-    for (int i = 0; i < pageOrder.size(); ++i) {
-        pageArgs << inputPath << QString::number(pageOrder.at(i));
+    TraceSpan reorderSpan("reorder", &m_report);
+    reorderSpan.setArg("pages", pageOrder.size());
+    reorderSpan.addFileRead(inputPath);
+    
+    // Describe the reorder as a qpdf job file: the input is opened once and
+    // the page list is stored as compact ranges instead of one argv pair per page
+    QString jobFile = QDir(workDir).filePath("reorder.json");
+    QString jobError;
+    QList<QPair<QString, QString>> pageSpecs;
+    pageSpecs.append(qMakePair(inputPath, compactPageRanges(pageOrder)));
+    if (!writeQpdfJobFile(jobFile, pageSpecs, reorderedPdf, jobError)) {
+        qDebug() << jobError;
+        completeJob(false, jobError);
+        return false;
     }
-    pageArgs << "--" << reorderedPdf;
+    
+    QStringList pageArgs;
+    pageArgs << "--job-json-file=" + jobFile;
     
     qDebug() << "Reordering pages...";
-    QProcess reorderProcess;
-    reorderProcess.start(PathConfig::qpdfPath, pageArgs);
-    if (!reorderProcess.waitForFinished(60000)) {
-        QString error = "Failed to reorder pages: " + reorderProcess.errorString();
+    ToolProcess reorderProcess;
+    if (!runTool(reorderProcess, PathConfig::qpdfPath, pageArgs, "reorder", pageOrder.size(),
+                 QFileInfo(inputPath).size())) {
+        debugProcess(reorderProcess, PathConfig::qpdfPath, pageArgs);
+        QString error = "Failed to reorder pages: " + toolError(reorderProcess);
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    qDebug() << "--- Reorder Process Debug Info ---";
-    qDebug() << "Command:" << PathConfig::qpdfPath;
-    qDebug() << "Arguments:" << pageArgs.join(" ");
-    qDebug() << "Exit code:" << reorderProcess.exitCode();
-    
-    QString stdout = reorderProcess.readAllStandardOutput();
-    QString stderr = reorderProcess.readAllStandardError();
-    if (!stdout.isEmpty()) qDebug() << "STDOUT:" << stdout;
-    if (!stderr.isEmpty()) qDebug() << "STDERR:" << stderr;
-    qDebug() << "--- End Reorder Process Debug ---";
-    
     // qpdf exit codes: 0 = success, 3 = success with warnings, 2+ = error
     int exitCode = reorderProcess.exitCode();
-    if (exitCode != 0 && exitCode != 3) {
+    bool reordered = exitCode == 0 || exitCode == 3;
+    if (!reordered || lcToolOutput().isDebugEnabled()) {
+        debugProcess(reorderProcess, PathConfig::qpdfPath, pageArgs);
+    }
+    if (!reordered) {
         QString error = QString("Failed to reorder pages, exit code: %1").arg(exitCode);
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
@@ -349,242 +659,967 @@ bool QPDFBookletCreator::createCombinedPage(const QString &inputPath, const QStr
     if (!reorderedInfo.exists()) {
         QString error = "Reordered PDF was not created at expected location: " + reorderedPdf;
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     qDebug() << "Reordered PDF created successfully, size:" << reorderedInfo.size() << "bytes";
+    reorderSpan.addBytesWritten(reorderedInfo.size());
+    reorderSpan.finish();
+    checkpoint("reorder", reorderedPdf);
+    return true;
+}
+
+QString QPDFBookletCreator::compactPageRanges(const QList<int> &pageOrder)
+{
+    // Collapse runs of consecutive pages (ascending or descending) into
+    // qpdf ranges, e.g. 8,1,2,7,6,3,4,5 -> "8,1-2,7-6,3-5"
+    QStringList ranges;
+    int i = 0;
+    while (i < pageOrder.size()) {
+        int start = pageOrder.at(i);
+        int end = start;
+        int step = 0;
+        int j = i + 1;
+        if (j < pageOrder.size() && qAbs(pageOrder.at(j) - start) == 1) {
+            step = pageOrder.at(j) - start;
+            while (j < pageOrder.size() && pageOrder.at(j) == end + step) {
+                end = pageOrder.at(j);
+                ++j;
+            }
+        }
+        ranges << (start == end ? QString::number(start) : QString("%1-%2").arg(start).arg(end));
+        i = j;
+    }
+    return ranges.join(",");
+}
+
+bool QPDFBookletCreator::writeQpdfJobFile(const QString &jobPath,
+                                          const QList<QPair<QString, QString>> &pageSpecs,
+                                          const QString &outputPath, QString &error)
+{
+    QJsonArray pages;
+    for (const auto &spec : pageSpecs) {
+        QJsonObject pageSpec;
+        pageSpec["file"] = spec.first;
+        pageSpec["range"] = spec.second;
+        pages.append(pageSpec);
+    }
     
-    // For 4-up layout, we want original page order, not booklet reordering
-    // Create 4-up layout for 2 identical booklets from 1 A4 sheet
-    qDebug() << "Creating 4-up layout for 2 identical booklets...";
-    return create4UpFor2Booklets(inputPath, outputPath);
+    QJsonObject job;
+    job["empty"] = "";
+    job["outputFile"] = outputPath;
+    job["progress"] = "";
+    if (m_reproducible) {
+        job["deterministicId"] = "";
+    }
+    job["pages"] = pages;
+    
+    QFile jobFile(jobPath);
+    if (!jobFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = "Failed to write qpdf job file: " + jobPath;
+        return false;
+    }
+    jobFile.write(QJsonDocument(job).toJson(QJsonDocument::Compact));
+    jobFile.close();
+    
+    qDebug() << "Wrote qpdf job file:" << jobPath << "with" << pageSpecs.size() << "page specs";
+    return true;
 }
 
-bool QPDFBookletCreator::create4UpFor2Booklets(const QString &inputPath, const QString &outputPath)
+QList<int> QPDFBookletCreator::bookletPageOrder(int totalPages, bool startFromBeginning) const
 {
-    qDebug() << "=== Creating 4-up layout using direct LaTeX approach ===";
+    QList<int> pageOrder;
+    int sheetsNeeded = totalPages / 4;
     
-    // Get page count of reordered PDF
-    QProcess pageCountProcess;
-    pageCountProcess.start(PathConfig::qpdfPath, QStringList() << "--show-npages" << inputPath);
-    if (!pageCountProcess.waitForFinished(30000)) {
-        QString error = "Failed to get page count for 4-up layout: " + pageCountProcess.errorString();
-        qDebug() << error;
-        emit processingComplete(false, error);
+    for (int sheet = 0; sheet < sheetsNeeded; sheet++) {
+        if (startFromBeginning) {
+            // Standard booklet ordering (first page is cover)
+            pageOrder.append(totalPages - sheet * 2);
+            pageOrder.append(sheet * 2 + 1);
+            pageOrder.append(sheet * 2 + 2);
+            pageOrder.append(totalPages - sheet * 2 - 1);
+        } else {
+            // Reverse ordering (last page is cover)
+            pageOrder.append(sheet * 2 + 1);
+            pageOrder.append(totalPages - sheet * 2);
+            pageOrder.append(totalPages - sheet * 2 - 1);
+            pageOrder.append(sheet * 2 + 2);
+        }
+    }
+    
+    return pageOrder;
+}
+
+int QPDFBookletCreator::pageCountOf(const QString &pdfPath, QString &error)
+{
+    ToolProcess pageCountProcess;
+    QStringList pageCountArgs;
+    pageCountArgs << "--show-npages" << pdfPath;
+    
+    if (!runTool(pageCountProcess, PathConfig::qpdfPath, pageCountArgs, "pagecount", 0,
+                 QFileInfo(pdfPath).size())) {
+        debugProcess(pageCountProcess, PathConfig::qpdfPath, pageCountArgs);
+        error = "Failed to get page count (timeout or process error): " + toolError(pageCountProcess);
+        return -1;
+    }
+    
+    int exitCode = pageCountProcess.exitCode();
+    if (exitCode != 0 && exitCode != 3) {
+        debugProcess(pageCountProcess, PathConfig::qpdfPath, pageCountArgs);
+        error = QString("qpdf failed with exit code %1").arg(exitCode);
+        return -1;
+    }
+    
+    QString pageCountOutput = QString::fromUtf8(m_toolStdout.contents()).trimmed();
+    bool ok;
+    int pageCount = pageCountOutput.toInt(&ok);
+    if (!ok || pageCount <= 0) {
+        error = QString("Invalid page count: '%1'").arg(pageCountOutput);
+        return -1;
+    }
+    
+    return pageCount;
+}
+
+bool QPDFBookletCreator::warmUp()
+{
+    return !findPdflatex().isEmpty();
+}
+
+bool QPDFBookletCreator::releaseStreamingParts(const QString &outputPath)
+{
+    QDir partsDir(outputPath + ".parts");
+    return !partsDir.exists() || partsDir.removeRecursively();
+}
+
+void QPDFBookletCreator::setJournal(JobJournal *journal, const QString &jobKey)
+{
+    m_journal = journal;
+    m_journalKey = journal ? jobKey : QString();
+}
+
+QString QPDFBookletCreator::durableScratch(const QString &name) const
+{
+    if (!m_journal) {
+        return QString();
+    }
+    return QDir(m_journal->scratchPath(m_journalKey)).filePath(name);
+}
+
+QString QPDFBookletCreator::resumeArtifact(const QString &stage)
+{
+    if (!m_journal) {
+        return QString();
+    }
+    QString artifact = m_journal->completedArtifact(m_journalKey, stage);
+    if (!artifact.isEmpty()) {
+        qDebug() << "Resuming after" << stage << "with" << artifact;
+        m_progress.dropStage(stage);
+    }
+    return artifact;
+}
+
+void QPDFBookletCreator::checkpoint(const QString &stage, const QString &artifactPath)
+{
+    // A journal that cannot be written only costs the resume, not the job
+    if (m_journal && !m_journal->recordStage(m_journalKey, stage, artifactPath)) {
+        qDebug() << "Could not checkpoint" << stage << "in" << m_journal->path();
+    }
+}
+
+QString QPDFBookletCreator::findPdflatex()
+{
+    if (!m_pdflatexPath.isEmpty()) {
+        return m_pdflatexPath;
+    }
+    
+    // Usually resolved once by PathConfig for the whole process
+    m_pdflatexPath = PathConfig::pdflatexPath;
+    if (m_pdflatexPath.isEmpty()) {
+        // Same lookup, with the probes run like any other tool
+        m_pdflatexPath = PathConfig::findPdflatex([this](const QString &location) {
+            ToolProcess latexCheck;
+            return runTool(latexCheck, location, QStringList() << "--version", "probe")
+                && latexCheck.exitCode() == 0;
+        });
+    }
+    return m_pdflatexPath;
+}
+
+bool QPDFBookletCreator::compileSheets(const QString &workDir, const QString &inputPath,
+                                       const QStringList &pageList, const SheetGrid &grid,
+                                       QString &pdfPath, QString &error)
+{
+    TraceSpan compileSpan("compile", &m_report);
+    compileSpan.setArg("sheets", pageList.size() / (grid.columns * grid.rows));
+    compileSpan.addFileRead(inputPath);
+    
+    QString pdflatexPath = findPdflatex();
+    if (pdflatexPath.isEmpty()) {
+        error = "pdflatex not found in common locations. Please ensure MacTeX is installed and in PATH.";
         return false;
     }
     
-    int pageCount = pageCountProcess.readAllStandardOutput().trimmed().toInt();
-    qDebug() << "Input has" << pageCount << "pages for 4-up layout";
+    QDir().mkpath(workDir);
+    QString layoutTex = workDir + "/layout.tex";
+    pdfPath = workDir + "/layout.pdf";
     
-    if (pageCount != 8) {
-        QString error = QString("Expected 8 pages for 4-up layout, got %1").arg(pageCount);
-        qDebug() << error;
-        emit processingComplete(false, error);
+    QFile tex(layoutTex);
+    if (!tex.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        error = "Failed to create LaTeX file for sheet layout";
         return false;
     }
     
-    QTemporaryDir tempDir;
-    if (!tempDir.isValid()) {
-        QString error = "Could not create temporary directory for 4-up layout";
-        qDebug() << error;
-        emit processingComplete(false, error);
+    QString paperSize = grid.landscape
+        ? "paperwidth=11.69in,paperheight=8.27in"
+        : "paperwidth=8.27in,paperheight=11.69in";
+    
+    // Each source page is imported once with \pdfximage and every placement
+    // only references that Form XObject, so a page shown twice on a sheet
+    // (or on several sheets) is embedded once. pdfTeX also imports shared
+    // fonts and images of the input file only once.
+    QTextStream out(&tex);
+    if (m_reproducible) {
+        // Fixed /ID, and no PTEX.* keys carrying the scratch file names
+        out << "\\pdftrailerid{" << m_reproducibleId << "}\n";
+        out << "\\pdfsuppressptexinfo=-1\n";
+    }
+    out << "\\documentclass{article}\n";
+    out << "\\usepackage[margin=0in," << paperSize << "]{geometry}\n";
+    out << "\\usepackage{graphicx}\n";
+    out << "\\pagestyle{empty}\n";
+    out << "\\setlength{\\parindent}{0pt}\n";
+    out << "\\setlength{\\topskip}{0pt}\n";
+    out << "\\newdimen\\slotwidth \\slotwidth=\\dimexpr\\paperwidth/" << grid.columns << "\\relax\n";
+    out << "\\newdimen\\slotheight \\slotheight=\\dimexpr\\paperheight/" << grid.rows << "\\relax\n";
+    out << "\\newdimen\\slotimagewidth\n";
+    out << "\\newcommand\\bookletinput{" << inputPath << "}\n";
+    out << "\\newcommand\\sourcepage[1]{%\n"
+        << "  \\ifcsname bookletpage@#1\\endcsname\\else\n"
+        << "    \\immediate\\pdfximage page #1 {\\bookletinput}%\n"
+        << "    \\expandafter\\xdef\\csname bookletpage@#1\\endcsname{\\the\\pdflastximage}%\n"
+        << "  \\fi\n"
+        << "  \\setbox0=\\hbox{\\pdfrefximage\\csname bookletpage@#1\\endcsname}%\n"
+        << "  \\slotimagewidth=\\dimexpr\\slotheight*\\wd0/\\ht0\\relax\n"
+        << "  \\ifdim\\slotimagewidth>\\slotwidth \\slotimagewidth=\\slotwidth\\fi\n"
+        << "  \\vbox to\\slotheight{\\vss\\hbox to\\slotwidth{\\hss\\resizebox{\\slotimagewidth}{!}{\\box0}\\hss}\\vss}}\n";
+    out << "\\newcommand\\blankslot{\\vbox to\\slotheight{\\vss\\hbox to\\slotwidth{\\hss}\\vss}}\n";
+    out << "\\begin{document}\n";
+    
+    int slotsPerSheet = grid.columns * grid.rows;
+    for (int sheetStart = 0; sheetStart < pageList.size(); sheetStart += slotsPerSheet) {
+        out << "\\vbox to\\paperheight{\\offinterlineskip\n";
+        for (int row = 0; row < grid.rows; ++row) {
+            out << "  \\hbox{";
+            for (int column = 0; column < grid.columns; ++column) {
+                const QString &page = pageList.at(sheetStart + row * grid.columns + column);
+                if (page == "{}") {
+                    out << "\\blankslot";
+                } else {
+                    out << "\\sourcepage{" << page << "}";
+                }
+            }
+            out << "}\n";
+        }
+        out << "  \\vss}\n";
+        out << "\\newpage\n";
+    }
+    out << "\\end{document}\n";
+    tex.close();
+    
+    qDebug() << "Created LaTeX file for sheet layout:" << layoutTex;
+    
+    int sheetCount = pageList.size() / slotsPerSheet;
+    
+    ToolProcess pdflatex;
+    pdflatex.setWorkingDirectory(workDir);
+    if (m_reproducible) {
+        // Pin the document dates pdfTeX writes into /Info
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("SOURCE_DATE_EPOCH", QString::number(m_reproducibleEpoch));
+        environment.insert("FORCE_SOURCE_DATE", "1");
+        pdflatex.setProcessEnvironment(environment);
+    }
+    QStringList pdflatexArgs;
+    pdflatexArgs << "-interaction=nonstopmode" << "layout.tex";
+    if (!runTool(pdflatex, pdflatexPath, pdflatexArgs, "compile", sheetCount,
+                 QFileInfo(inputPath).size())) {
+        debugProcess(pdflatex, pdflatexPath, pdflatexArgs);
+        error = "pdflatex failed to finish the sheet layout: " + toolError(pdflatex);
         return false;
     }
     
-    // Check if pdflatex is available - try common paths
-    QString pdflatexPath;
-    QStringList pdflatexLocations = {
-        "/usr/local/texlive/2024/bin/universal-darwin/pdflatex",
-        "/usr/local/texlive/2023/bin/universal-darwin/pdflatex",
-        "/opt/homebrew/bin/pdflatex",
-        "/usr/local/bin/pdflatex",
-        "pdflatex"  // fallback to PATH
-    };
+    bool compiled = pdflatex.exitCode() == 0 && QFile::exists(pdfPath);
+    if (!compiled || lcToolOutput().isDebugEnabled()) {
+        debugProcess(pdflatex, pdflatexPath, pdflatexArgs);
+    }
     
-    for (const QString &location : pdflatexLocations) {
-        QProcess latexCheck;
-        latexCheck.start(location, QStringList() << "--version");
-        if (latexCheck.waitForFinished(10000) && latexCheck.exitCode() == 0) {
-            pdflatexPath = location;
-            qDebug() << "Found pdflatex at:" << pdflatexPath;
-            break;
-        }
+    if (!compiled) {
+        error = QString("Failed to compile sheet layout LaTeX, exit code: %1").arg(pdflatex.exitCode());
+        return false;
     }
     
+    compileSpan.addFileWritten(pdfPath);
+    return true;
+}
+
+bool QPDFBookletCreator::compileSheetsInTasks(const QString &workDir, const QString &inputPath,
+                                              const QStringList &pageList, const SheetGrid &grid,
+                                              QString &pdfPath, QString &error)
+{
+    int slotsPerSheet = grid.columns * grid.rows;
+    int sheetCount = pageList.size() / slotsPerSheet;
+    if (!compilesInTasks(sheetCount)) {
+        return compileSheets(workDir, inputPath, pageList, grid, pdfPath, error);
+    }
+    
+    // Resolved once here rather than probed by every task
+    QString pdflatexPath = findPdflatex();
     if (pdflatexPath.isEmpty()) {
-        QString error = "pdflatex not found in common locations. Please ensure MacTeX is installed and in PATH.";
-        qDebug() << error;
-        emit processingComplete(false, error);
+        error = "pdflatex not found in common locations. Please ensure MacTeX is installed and in PATH.";
         return false;
     }
     
-    qDebug() << "pdflatex found, creating direct LaTeX solution...";
+    struct Chunk {
+        int firstSheet;
+        int sheets;
+        bool ok = false;
+        QString pdfPath;
+        QString error;
+        ResourceReport report;
+    };
     
-    // Create sheet1: pages 1,2,3,4 in 2x2 layout
-    QString sheet1Dir = tempDir.filePath("sheet1");
-    QDir().mkpath(sheet1Dir);
-    QString sheet1Tex = sheet1Dir + "/sheet1.tex";
-    QString sheet1Pdf = sheet1Dir + "/sheet1.pdf";
+    int chunkSheets = sheetsPerTask();
+    QList<Chunk> chunks;
+    for (int firstSheet = 0; firstSheet < sheetCount; firstSheet += chunkSheets) {
+        Chunk chunk;
+        chunk.firstSheet = firstSheet;
+        chunk.sheets = qMin(chunkSheets, sheetCount - firstSheet);
+        chunks.append(chunk);
+    }
+    qDebug() << "Compiling" << sheetCount << "sheets as" << chunks.size() << "tasks on"
+             << TaskScheduler::instance().workerCount() << "workers";
+    
+    QDir().mkpath(workDir);
+    m_progress.beginRun("compile", sheetCount, QFileInfo(inputPath).size());
+    logProgress();
+    
+    QAtomicInt sheetsDone;
+    {
+        TaskScheduler::Group group;
+        for (Chunk &chunk : chunks) {
+            Chunk *task = &chunk;
+            group.run([this, task, workDir, inputPath, pageList, grid, slotsPerSheet,
+                       pdflatexPath, &sheetsDone]() {
+                // A creator of its own keeps the tool output, progress and
+                // report of this task apart from every other task
+                QPDFBookletCreator chunkCreator;
+                chunkCreator.m_governorJob = m_governorJob ? m_governorJob : quintptr(this);
+                chunkCreator.setPdflatexPath(pdflatexPath);
+                chunkCreator.m_reproducible = m_reproducible;
+                chunkCreator.m_reproducibleId = m_reproducibleId;
+                chunkCreator.m_reproducibleEpoch = m_reproducibleEpoch;
+                
+                QStringList chunkPages = pageList.mid(task->firstSheet * slotsPerSheet,
+                                                      task->sheets * slotsPerSheet);
+                QString chunkDir = QString("%1/sheets-%2").arg(workDir).arg(task->firstSheet + 1, 5, 10, QChar('0'));
+                task->ok = chunkCreator.compileSheets(chunkDir, inputPath, chunkPages, grid,
+                                                      task->pdfPath, task->error);
+                task->report = chunkCreator.m_report;
+                sheetsDone.fetchAndAddRelaxed(task->sheets);
+            });
+        }
+        
+        // Help with queued tasks (of this or other jobs) while waiting
+        group.wait([this, &sheetsDone, sheetCount]() {
+            m_progress.setRunFraction(double(sheetsDone.loadRelaxed()) / sheetCount);
+            logProgress();
+        });
+    }
+    m_progress.finishRun();
+    logProgress();
+    
+    QList<QPair<QString, QString>> chunkSpecs;
+    for (const Chunk &chunk : std::as_const(chunks)) {
+        m_report.mergeToolRuns(chunk.report);
+        if (!chunk.ok) {
+            error = QString("Sheets %1 to %2: %3").arg(chunk.firstSheet + 1)
+                                                   .arg(chunk.firstSheet + chunk.sheets)
+                                                   .arg(chunk.error);
+            return false;
+        }
+        chunkSpecs.append(qMakePair(chunk.pdfPath, QString("1-z")));
+    }
     
-    QFile tex1(sheet1Tex);
-    if (!tex1.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QString error = "Failed to create LaTeX file for sheet1";
-        qDebug() << error;
-        emit processingComplete(false, error);
+    // Stitch the sheet ranges back together in order
+    TraceSpan combineSpan("combine", &m_report);
+    pdfPath = workDir + "/layout.pdf";
+    QString jobFile = workDir + "/combine.json";
+    if (!writeQpdfJobFile(jobFile, chunkSpecs, pdfPath, error)) {
         return false;
     }
     
-    QTextStream out1(&tex1);
-    out1 << "\\documentclass{article}\n";
-    out1 << "\\usepackage[margin=0in,paperwidth=8.27in,paperheight=11.69in]{geometry}\n";
-    out1 << "\\usepackage{pdfpages}\n";
-    out1 << "\\begin{document}\n";
-    // For 2x2 grid: contact details, picture, contact details, picture
-    // This should be pages 1,2,3,4 from original PDF which are contact, picture, contact, picture
-    out1 << "\\includepdf[pages={1,2,3,4},nup=2x2,landscape=false]{" << inputPath << "}\n";
-    out1 << "\\end{document}\n";
-    tex1.close();
+    ToolProcess combineProcess;
+    QStringList combineArgs;
+    combineArgs << "--job-json-file=" + jobFile;
+    if (!runTool(combineProcess, PathConfig::qpdfPath, combineArgs, "combine", sheetCount)) {
+        debugProcess(combineProcess, PathConfig::qpdfPath, combineArgs);
+        error = "Failed to combine compiled sheets: " + toolError(combineProcess);
+        return false;
+    }
     
-    qDebug() << "Created LaTeX file for sheet1:" << sheet1Tex;
+    int exitCode = combineProcess.exitCode();
+    if ((exitCode != 0 && exitCode != 3) || !QFile::exists(pdfPath)) {
+        debugProcess(combineProcess, PathConfig::qpdfPath, combineArgs);
+        error = QString("Failed to combine compiled sheets, exit code: %1").arg(exitCode);
+        return false;
+    }
+    combineSpan.addFileWritten(pdfPath);
+    return true;
+}
+
+int QPDFBookletCreator::sheetsPerTask()
+{
+    bool ok;
+    int sheets = qEnvironmentVariableIntValue("BOOKLET_SHEETS_PER_TASK", &ok);
+    return ok && sheets >= 0 ? sheets : 16;
+}
+
+bool QPDFBookletCreator::compilesInTasks(int sheetCount)
+{
+    // Every task pays a pdflatex start-up and the stitch costs a qpdf run,
+    // so only layouts of several tasks' worth of sheets are split
+    int chunkSheets = sheetsPerTask();
+    return chunkSheets > 0 && sheetCount >= 2 * chunkSheets
+        && TaskScheduler::instance().workerCount() > 1;
+}
+
+void QPDFBookletCreator::pinReproducibleFields(const QString &inputPath, const QStringList &pageList,
+                                               const SheetGrid &grid)
+{
+    // Everything that can change the output bytes goes into the job hash
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QFile input(inputPath);
+    if (input.open(QIODevice::ReadOnly)) {
+        hash.addData(&input);
+    }
+    hash.addData(pageList.join(",").toUtf8());
+    hash.addData(QString("%1x%2:%3").arg(grid.columns).arg(grid.rows).arg(grid.landscape).toUtf8());
+    hash.addData(QString("dedup=%1;dpi=%2;q=%3;objstm=%4;level=%5;linear=%6;stream=%7")
+                 .arg(m_optimizerOptions.deduplicateResources)
+                 .arg(m_optimizerOptions.downsampleDpi)
+                 .arg(m_optimizerOptions.jpegQuality)
+                 .arg(m_optimizerOptions.objectStreams)
+                 .arg(m_optimizerOptions.compressionLevel)
+                 .arg(m_optimizerOptions.linearize)
+                 .arg(m_streamingOutput).toUtf8());
+    QByteArray digest = hash.result();
+    
+    m_reproducibleId = digest.left(16).toHex();
+    
+    // An explicit SOURCE_DATE_EPOCH wins; otherwise the date is derived
+    // from the hash, inside 2000-01-01 .. 2030-01-01
+    bool ok;
+    m_reproducibleEpoch = qEnvironmentVariable("SOURCE_DATE_EPOCH").toLongLong(&ok);
+    if (!ok) {
+        const qint64 base = 946684800;
+        const qint64 span = 30LL * 365 * 24 * 3600;
+        quint64 value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value = (value << 8) | static_cast<quint8>(digest.at(16 + i));
+        }
+        m_reproducibleEpoch = base + static_cast<qint64>(value % span);
+    }
+    
+    qDebug() << "Reproducible output: id" << m_reproducibleId << "epoch" << m_reproducibleEpoch;
+}
+
+bool QPDFBookletCreator::layoutSheets(const QString &inputPath, const QString &outputPath,
+                                      const QList<int> &pageOrder, const SheetGrid &grid,
+                                      const QString &successMessage)
+{
+    qDebug() << "=== Laying out sheets ===";
+    qDebug() << "Input path:" << inputPath;
+    qDebug() << "Output path:" << outputPath;
+    qDebug() << "Grid:" << grid.columns << "x" << grid.rows << (grid.landscape ? "landscape" : "portrait");
+    qDebug() << "Streaming output:" << m_streamingOutput;
     
-    // Compile sheet1
-    QProcess pdflatex1;
-    pdflatex1.setWorkingDirectory(sheet1Dir);
-    pdflatex1.start(pdflatexPath, QStringList() << "-interaction=nonstopmode" << "sheet1.tex");
-    if (!pdflatex1.waitForFinished(60000)) {
-        QString error = "pdflatex timeout for sheet1: " + pdflatex1.errorString();
+    TraceSpan layoutSpan("layout", &m_report);
+    layoutSpan.setArg("slots", pageOrder.size());
+    
+    int slotsPerSheet = grid.columns * grid.rows;
+    if (pageOrder.isEmpty() || slotsPerSheet <= 0) {
+        QString error = "Nothing to lay out: empty page order or grid";
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    qDebug() << "--- Sheet1 LaTeX Debug ---";
-    qDebug() << "Exit code:" << pdflatex1.exitCode();
-    QString stdout1 = pdflatex1.readAllStandardOutput();
-    QString stderr1 = pdflatex1.readAllStandardError();
-    if (!stdout1.isEmpty()) qDebug() << "STDOUT:" << stdout1;
-    if (!stderr1.isEmpty()) qDebug() << "STDERR:" << stderr1;
-    qDebug() << "--- End Sheet1 LaTeX Debug ---";
-    
-    if (pdflatex1.exitCode() != 0 || !QFile::exists(sheet1Pdf)) {
-        QString error = QString("Failed to compile sheet1 LaTeX, exit code: %1").arg(pdflatex1.exitCode());
+    qint64 inputBytes = QFileInfo(inputPath).size();
+    ScratchDir tempDir(durableScratch("layout"), inputBytes * 2, &m_report);
+    if (!tempDir.isValid()) {
+        QString error = "Could not create temporary directory for sheet layout";
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    qDebug() << "Sheet1 compiled successfully";
+    // Entry points without a preflight of their own are planned here
+    planLayout(pageOrder.size(), grid, inputBytes);
+    logProgress();
+    
+    // Downsample oversized images once on the input side, before pages are
+    // placed (and possibly duplicated) on sheets
+    QString sourcePath = inputPath;
+    QString resumedDownsample = m_optimizerOptions.downsampleDpi > 0 ? resumeArtifact("downsample") : QString();
+    if (!resumedDownsample.isEmpty()) {
+        sourcePath = resumedDownsample;
+    } else if (m_optimizerOptions.downsampleDpi > 0) {
+        PdfOptimizer::Options inputPass;
+        inputPass.downsampleDpi = m_optimizerOptions.downsampleDpi;
+        inputPass.jpegQuality = m_optimizerOptions.jpegQuality;
+        // Pages are scaled to fit their slot, up as well as down
+        QSizeF paper = grid.landscape ? QSizeF(A4_HEIGHT, A4_WIDTH) : QSizeF(A4_WIDTH, A4_HEIGHT);
+        inputPass.placementSlot = QSizeF(paper.width() / grid.columns, paper.height() / grid.rows);
+        
+        TraceSpan downsampleSpan("downsample", &m_report);
+        downsampleSpan.addFileRead(inputPath);
+        m_progress.beginRun("downsample", pageOrder.size(), inputBytes);
+        logProgress();
+        QElapsedTimer downsampleTimer;
+        downsampleTimer.start();
+        
+        QString downsampledPdf = tempDir.filePath("downsampled.pdf");
+        QString downsampleError;
+        if (!PdfOptimizer::optimize(inputPath, downsampledPdf, inputPass, downsampleError)) {
+            qDebug() << downsampleError;
+            completeJob(false, downsampleError);
+            return false;
+        }
+        downsampleSpan.addFileWritten(downsampledPdf);
+        checkpoint("downsample", downsampledPdf);
+        StageWatchdog("downsample", pageOrder.size(), inputBytes).recordCompletion(downsampleTimer.elapsed());
+        m_progress.finishRun();
+        logProgress();
+        sourcePath = downsampledPdf;
+    }
+    
+    // Fill the last sheet with blank slots so every sheet has a full grid
+    QStringList pageList;
+    for (int page : pageOrder) {
+        pageList << (page > 0 ? QString::number(page) : QString("{}"));
+    }
+    while (pageList.size() % slotsPerSheet != 0) {
+        pageList << "{}";
+    }
+    
+    int sheetCount = pageList.size() / slotsPerSheet;
+    qDebug() << "Laying out" << pageList.size() << "slots on" << sheetCount << "sheets";
+    
+    if (m_reproducible) {
+        pinReproducibleFields(inputPath, pageList, grid);
+    }
     
-    // Create sheet2: pages 5,6,7,8 in 2x2 layout
-    QString sheet2Dir = tempDir.filePath("sheet2");
-    QDir().mkpath(sheet2Dir);
-    QString sheet2Tex = sheet2Dir + "/sheet2.tex";
-    QString sheet2Pdf = sheet2Dir + "/sheet2.pdf";
+    if (QFile::exists(outputPath)) {
+        QFile::remove(outputPath);
+    }
     
-    QFile tex2(sheet2Tex);
-    if (!tex2.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QString error = "Failed to create LaTeX file for sheet2";
+    QString error;
+    if (!m_streamingOutput) {
+        QString layoutPdf = resumeArtifact("compile");
+        if (layoutPdf.isEmpty()) {
+            if (!compileSheetsInTasks(tempDir.filePath("layout"), sourcePath, pageList, grid, layoutPdf, error)) {
+                qDebug() << error;
+                completeJob(false, error);
+                return false;
+            }
+            checkpoint("compile", layoutPdf);
+        }
+        
+        if (!QFile::copy(layoutPdf, outputPath)) {
+            error = "Failed to write final output to: " + outputPath;
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+    } else {
+        // Publish sheets in parts next to the output as soon as each part is
+        // compiled. The first part holds a single sheet and part sizes double
+        // up to a cap, so the first sheet is ready quickly while long runs
+        // only pay a few extra pdflatex start-ups.
+        auto partName = [](int firstSheet, int lastSheet) {
+            return QString("sheets-%1-%2").arg(firstSheet + 1, 5, 10, QChar('0'))
+                                          .arg(lastSheet + 1, 5, 10, QChar('0'));
+        };
+        
+        // Parts an interrupted attempt already published are kept and
+        // skipped; the first part always covers the first sheet alone
+        QDir partsDir(outputPath + ".parts");
+        if (resumeArtifact(partName(0, 0)).isEmpty()) {
+            partsDir.removeRecursively();
+        }
+        if (!QDir().mkpath(partsDir.path())) {
+            error = "Cannot create sheet parts directory: " + partsDir.path();
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        
+        QList<QPair<QString, QString>> partSpecs;
+        int firstSheet = 0;
+        int partSize = 1;
+        while (firstSheet < sheetCount) {
+            int lastSheet = qMin(firstSheet + partSize, sheetCount) - 1;
+            QStringList partPages = pageList.mid(firstSheet * slotsPerSheet,
+                                                 (lastSheet - firstSheet + 1) * slotsPerSheet);
+            
+            QString publishedPart = partsDir.filePath(partName(firstSheet, lastSheet) + ".pdf");
+            if (resumeArtifact(partName(firstSheet, lastSheet)) != publishedPart) {
+                QString partPdf;
+                QString partWorkDir = tempDir.filePath(QString("part%1").arg(partSpecs.size() + 1));
+                if (!compileSheets(partWorkDir, sourcePath, partPages, grid, partPdf, error)) {
+                    qDebug() << error;
+                    completeJob(false, error);
+                    return false;
+                }
+                
+                QFile::remove(publishedPart);
+                if (!QFile::copy(partPdf, publishedPart)) {
+                    error = "Failed to publish sheet part: " + publishedPart;
+                    qDebug() << error;
+                    completeJob(false, error);
+                    return false;
+                }
+                checkpoint(partName(firstSheet, lastSheet), publishedPart);
+            }
+            
+            qDebug() << "Sheets" << firstSheet + 1 << "to" << lastSheet + 1 << "ready:" << publishedPart;
+            emit sheetsReady(firstSheet + 1, lastSheet + 1, sheetCount, publishedPart);
+            
+            partSpecs.append(qMakePair(publishedPart, QString("1-z")));
+            firstSheet = lastSheet + 1;
+            partSize = qMin(partSize * 2, 32);
+        }
+        
+        // Stitch the published parts into the final output
+        TraceSpan combineSpan("combine", &m_report);
+        for (const auto &spec : partSpecs) {
+            combineSpan.addFileRead(spec.first);
+        }
+        
+        QString jobFile = tempDir.filePath("combine.json");
+        if (!writeQpdfJobFile(jobFile, partSpecs, outputPath, error)) {
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        
+        ToolProcess combineProcess;
+        QStringList combineArgs;
+        combineArgs << "--job-json-file=" + jobFile;
+        if (!runTool(combineProcess, PathConfig::qpdfPath, combineArgs, "combine", sheetCount)) {
+            debugProcess(combineProcess, PathConfig::qpdfPath, combineArgs);
+            error = "Failed to combine sheet parts: " + toolError(combineProcess);
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        
+        int combineExitCode = combineProcess.exitCode();
+        if (combineExitCode != 0 && combineExitCode != 3) {
+            debugProcess(combineProcess, PathConfig::qpdfPath, combineArgs);
+            error = QString("Failed to combine sheet parts, exit code: %1").arg(combineExitCode);
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        combineSpan.addFileWritten(outputPath);
+    }
+    
+    if (!QFile::exists(outputPath)) {
+        error = "Final output was not created at: " + outputPath;
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    QTextStream out2(&tex2);
-    out2 << "\\documentclass{article}\n";
-    out2 << "\\usepackage[margin=0in,paperwidth=8.27in,paperheight=11.69in]{geometry}\n";
-    out2 << "\\usepackage{pdfpages}\n";
-    out2 << "\\begin{document}\n";
-    out2 << "\\includepdf[pages={5,6,7,8},nup=2x2,landscape=false]{" << inputPath << "}\n";
-    out2 << "\\end{document}\n";
-    tex2.close();
+    PdfOptimizer::Options outputPass = m_optimizerOptions;
+    outputPass.downsampleDpi = 0;
+    if (m_reproducible) {
+        outputPass.deterministic = true;
+        outputPass.sourceDateEpoch = m_reproducibleEpoch;
+    }
+    if (outputPass.isEnabled()) {
+        TraceSpan optimizeSpan("optimize", &m_report);
+        optimizeSpan.addFileRead(outputPath);
+        qint64 outputBytes = QFileInfo(outputPath).size();
+        m_progress.beginRun("optimize", sheetCount, outputBytes);
+        logProgress();
+        QElapsedTimer optimizeTimer;
+        optimizeTimer.start();
+        
+        QString optimizedPdf = tempDir.filePath("optimized.pdf");
+        if (!PdfOptimizer::optimize(outputPath, optimizedPdf, outputPass, error)) {
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        StageWatchdog("optimize", sheetCount, outputBytes).recordCompletion(optimizeTimer.elapsed());
+        m_progress.finishRun();
+        logProgress();
+        
+        QFile::remove(outputPath);
+        if (!QFile::copy(optimizedPdf, outputPath)) {
+            error = "Failed to write optimized output to: " + outputPath;
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        optimizeSpan.addFileWritten(outputPath);
+    }
+    
+    QFileInfo outputInfo(outputPath);
+    qDebug() << "Sheet layout created successfully!";
+    qDebug() << "Final output file:" << outputPath;
+    qDebug() << "Output file size:" << outputInfo.size() << "bytes";
+    
+    completeJob(true, successMessage);
+    return true;
+}
+
+bool QPDFBookletCreator::create2UpLayout(const QString &inputPath, const QString &outputPath)
+{
+    JobScope job(this);
     
-    qDebug() << "Created LaTeX file for sheet2:" << sheet2Tex;
+    qDebug() << "=== Creating 2-up booklet layout ===";
     
-    // Compile sheet2
-    QProcess pdflatex2;
-    pdflatex2.setWorkingDirectory(sheet2Dir);
-    pdflatex2.start(pdflatexPath, QStringList() << "-interaction=nonstopmode" << "sheet2.tex");
-    if (!pdflatex2.waitForFinished(60000)) {
-        QString error = "pdflatex timeout for sheet2: " + pdflatex2.errorString();
+    QString error;
+    int pageCount = pageCountOf(inputPath, error);
+    if (pageCount < 0) {
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    qDebug() << "--- Sheet2 LaTeX Debug ---";
-    qDebug() << "Exit code:" << pdflatex2.exitCode();
-    QString stdout2 = pdflatex2.readAllStandardOutput();
-    QString stderr2 = pdflatex2.readAllStandardError();
-    if (!stdout2.isEmpty()) qDebug() << "STDOUT:" << stdout2;
-    if (!stderr2.isEmpty()) qDebug() << "STDERR:" << stderr2;
-    qDebug() << "--- End Sheet2 LaTeX Debug ---";
+    // Pages past the end of the input become blank slots
+    int totalPages = ((pageCount + 3) / 4) * 4;
+    QList<int> pageOrder = bookletPageOrder(totalPages, true);
+    for (int &page : pageOrder) {
+        if (page > pageCount) {
+            page = 0;
+        }
+    }
+    
+    return layoutSheets(inputPath, outputPath, pageOrder, SheetGrid{2, 1, true},
+                        "2-up booklet created. Print double-sided (flip on short edge), fold and staple.");
+}
+
+bool QPDFBookletCreator::create2UpSheet(const QString &inputPath, const QString &outputPath, int leftPageNum, int rightPageNum)
+{
+    JobScope job(this);
+    
+    qDebug() << "=== Creating single 2-up sheet ===";
+    qDebug() << "Left page:" << leftPageNum << "Right page:" << rightPageNum;
     
-    if (pdflatex2.exitCode() != 0 || !QFile::exists(sheet2Pdf)) {
-        QString error = QString("Failed to compile sheet2 LaTeX, exit code: %1").arg(pdflatex2.exitCode());
+    return layoutSheets(inputPath, outputPath, QList<int>() << leftPageNum << rightPageNum,
+                        SheetGrid{2, 1, true}, "2-up sheet created.");
+}
+
+bool QPDFBookletCreator::createSequential2Up(const QString &inputPath, const QString &outputPath)
+{
+    JobScope job(this);
+    
+    qDebug() << "=== Creating sequential 2-up layout ===";
+    
+    QString error;
+    int pageCount = pageCountOf(inputPath, error);
+    if (pageCount < 0) {
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    qDebug() << "Sheet2 compiled successfully";
+    QList<int> pageOrder;
+    for (int page = 1; page <= pageCount; ++page) {
+        pageOrder.append(page);
+    }
     
-    // Combine the two sheets using qpdf
-    QStringList combineArgs;
-    combineArgs << "--empty" << "--pages" << sheet1Pdf << "1" << sheet2Pdf << "1" << "--" << outputPath;
+    return layoutSheets(inputPath, outputPath, pageOrder, SheetGrid{2, 1, true},
+                        "Sequential 2-up layout created.");
+}
+
+bool QPDFBookletCreator::create4UpFor2Booklets(const QString &inputPath, const QString &outputPath)
+{
+    JobScope job(this);
     
-    if (QFile::exists(outputPath)) {
-        QFile::remove(outputPath);
-    }
+    qDebug() << "=== Creating 4-up layout for 2 booklets ===";
     
-    qDebug() << "Combining sheets with qpdf...";
-    QProcess combineProcess;
-    combineProcess.start(PathConfig::qpdfPath, combineArgs);
-    if (!combineProcess.waitForFinished(60000)) {
-        QString error = "Failed to combine sheets: " + combineProcess.errorString();
+    QString error;
+    int pageCount = pageCountOf(inputPath, error);
+    if (pageCount < 0) {
+        error = "Failed to get page count for 4-up layout: " + error;
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    int combineExitCode = combineProcess.exitCode();
-    if (combineExitCode != 0 && combineExitCode != 3) {
-        QString error = QString("Failed to combine sheets, exit code: %1").arg(combineExitCode);
+    qDebug() << "Input has" << pageCount << "pages for 4-up layout";
+    
+    // The input is in booklet order, four pages per folded sheet: two for
+    // the front and two for the back. Each side is printed twice on the A4
+    // sheet (top and bottom half), so both placements share one XObject.
+    QList<int> pageOrder;
+    for (int page = 1; page <= pageCount; page += 2) {
+        int left = page;
+        int right = page + 1 <= pageCount ? page + 1 : 0;
+        pageOrder << left << right << left << right;
+    }
+    
+    return layoutSheets(inputPath, outputPath, pageOrder, SheetGrid{2, 2, false},
+                        "Perfect 4-up booklet created with LaTeX! Print double-sided, cut A4 sheet in half to create 2 identical booklets.");
+}
+
+bool QPDFBookletCreator::runStage(Stage stage, const QString &inputPath, const QString &outputPath)
+{
+    JobScope job(this);
+    
+    qDebug() << "=== Running stage" << static_cast<int>(stage) << "alone ===";
+    
+    QString error;
+    int pageCount;
+    {
+        TraceSpan preflightSpan("preflight", &m_report);
+        preflightSpan.addFileRead(inputPath);
+        pageCount = pageCountOf(inputPath, error);
+    }
+    if (pageCount < 0) {
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
+    if (stage == Stage::Preflight) {
+        completeJob(true, QString("Input has %1 pages.").arg(pageCount));
+        return true;
+    }
     
-    // Check final result
-    QFileInfo outputInfo(outputPath);
-    if (!outputInfo.exists()) {
-        QString error = "Final booklet was not created at: " + outputPath;
+    ScratchDir tempDir(QFileInfo(inputPath).size() * 2, &m_report);
+    if (!tempDir.isValid()) {
+        error = "Could not create temporary directory";
         qDebug() << error;
-        emit processingComplete(false, error);
+        completeJob(false, error);
         return false;
     }
     
-    qDebug() << "4-up booklet created successfully with direct LaTeX!";
-    qDebug() << "Final output file:" << outputPath;
-    qDebug() << "Output file size:" << outputInfo.size() << "bytes";
+    QString stagePdf;
+    if (stage == Stage::Padding) {
+        // Always add at least one blank page so the stage has work to do
+        int totalPages = (pageCount / 4 + 1) * 4;
+        if (!padPages(inputPath, pageCount, totalPages, tempDir.path(), stagePdf)) {
+            return false;
+        }
+    } else if (stage == Stage::Reorder) {
+        if (pageCount < 4) {
+            error = "Reordering needs at least four pages";
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+        QList<int> pageOrder = bookletPageOrder((pageCount / 4) * 4, true);
+        if (!reorderPages(inputPath, pageOrder, tempDir.path(), stagePdf)) {
+            return false;
+        }
+    } else {
+        QStringList pageList;
+        for (int page = 1; page <= pageCount; ++page) {
+            pageList << QString::number(page);
+        }
+        if (pageList.size() % 2 != 0) {
+            pageList << "{}";
+        }
+        if (!compileSheets(tempDir.filePath("layout"), inputPath, pageList, SheetGrid{2, 1, true},
+                           stagePdf, error)) {
+            qDebug() << error;
+            completeJob(false, error);
+            return false;
+        }
+    }
+    
+    QFile::remove(outputPath);
+    if (!QFile::copy(stagePdf, outputPath)) {
+        error = "Failed to write stage output to: " + outputPath;
+        qDebug() << error;
+        completeJob(false, error);
+        return false;
+    }
     
-    emit processingComplete(true, "Perfect 4-up booklet created with LaTeX! Print double-sided, cut A4 sheet in half to create 2 identical booklets.");
+    completeJob(true, "Stage completed.");
     return true;
 }
 
 QImage QPDFBookletCreator::renderPage(const QString &pdfPath, int pageNum)
 {
-    // This is a placeholder. In a real implementation, you would:
-    // 1. Use a PDF rendering library like Poppler or MuPDF to render the page to an image
-    // 2. Return that image for display
+    // The rendering backend is only loaded here, on first use
+    QString error;
+    std::unique_ptr<PdfRenderer> renderer = RendererLoader::createRenderer(error);
+    if (renderer && renderer->open(pdfPath, error)) {
+        QImage page = renderer->renderPage(pageNum - 1, 72);
+        if (!page.isNull()) {
+            return page;
+        }
+    }
+    qDebug() << "Cannot render page" << pageNum << "of" << pdfPath << error;
     
-    // For now, just return a blank image of A6 size
+    // Without a backend, return a blank image of A6 size
     return QImage(static_cast<int>(A6_WIDTH), static_cast<int>(A6_HEIGHT), QImage::Format_RGB32);
 }
 
-void QPDFBookletCreator::logProgress(int current, int total)
+void QPDFBookletCreator::planLayout(int slotCount, const SheetGrid &grid, qint64 inputBytes)
 {
-    int progress = (current * 100) / total;
-    emit progressChanged(progress);
+    int sheetCount = (slotCount + grid.columns * grid.rows - 1) / (grid.columns * grid.rows);
+    
+    // Streaming compiles parts of 1, 2, 4, ... 32 sheets, each a separate
+    // pdflatex run, and then combines them
+    int compileRuns = 1;
+    if (m_streamingOutput) {
+        compileRuns = 0;
+        for (int firstSheet = 0, partSize = 1; firstSheet < sheetCount; partSize = qMin(partSize * 2, 32)) {
+            firstSheet += partSize;
+            ++compileRuns;
+        }
+        m_progress.planStage("combine", sheetCount, 0);
+    } else if (compilesInTasks(sheetCount)) {
+        m_progress.planStage("combine", sheetCount, 0);
+    }
+    
+    if (m_optimizerOptions.downsampleDpi > 0) {
+        m_progress.planStage("downsample", slotCount, inputBytes);
+    }
+    m_progress.planStage("compile", sheetCount, inputBytes, compileRuns);
+    
+    PdfOptimizer::Options outputPass = m_optimizerOptions;
+    outputPass.downsampleDpi = 0;
+    if (outputPass.isEnabled() || m_reproducible) {
+        // The output is roughly as large as the input
+        m_progress.planStage("optimize", sheetCount, inputBytes);
+    }
+}
+
+void QPDFBookletCreator::logProgress()
+{
+    int progress = m_progress.percent();
+    bool moved = progress != m_lastProgress;
+    if (!moved && m_progressTimer.isValid() && m_progressTimer.elapsed() < 500) {
+        return;
+    }
+    m_progressTimer.start();
+    
+    qint64 remainingMs = m_progress.remainingMs();
+    if (moved) {
+        m_lastProgress = progress;
+        qDebug() << "Progress:" << progress << "%" << m_progress.currentStage()
+                 << ProgressEstimator::formatRemaining(remainingMs);
+        emit progressChanged(progress);
+    }
+    emit etaChanged(remainingMs, m_progress.currentStage());
 }
 
@@ -4,8 +4,20 @@
 #include <QObject>
 #include <QString>
 #include <QImage>
+#include <QByteArrayView>
+#include <functional>
 #include <memory>
 #include "pathconfig.h"
+#include "pdfoptimizer.h"
+#include "resourcereport.h"
+#include "outputring.h"
+#include "progressestimator.h"
+#include "toolprocess.h"
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+class JobJournal;
+class QIODevice;
 
 // Forward declarations for QPDF classes
 namespace PoDoFo {
@@ -28,11 +40,70 @@ public:
     bool createSequential2Up(const QString &inputPath, const QString &outputPath);
     bool createGhostscript2Up(const QString &inputPath, const QString &outputPath);
     bool create4UpFor2Booklets(const QString &inputPath, const QString &outputPath);
-    void debugProcess(QProcess &process, const QString &command, const QStringList &args);
+    void debugProcess(ToolProcess &process, const QString &command, const QStringList &args);
+    
+    // The same layouts for callers that hold the PDF in memory. A QByteArray
+    // converts to the view. The tools need a path, so the input goes to a
+    // scratch directory, on tmpfs when it fits, and nowhere else. The result
+    // is streamed into output, which must be open for writing. Streaming
+    // output parts are not published in this mode.
+    bool createBooklet(QByteArrayView input, QIODevice *output, bool startFromBeginning = true);
+    bool create2UpLayout(QByteArrayView input, QIODevice *output);
+    bool createSequential2Up(QByteArrayView input, QIODevice *output);
+    
+    // A single pipeline stage run on its own as a complete job, for the
+    // benchmark. Preflight only counts pages; padding appends at least one
+    // blank page up to a multiple of four; reorder writes the booklet page
+    // order of the first multiple of four pages; compile lays every page
+    // out 2-up with one pdflatex pass and no optimizer passes.
+    enum class Stage { Preflight, Padding, Reorder, Compile };
+    bool runStage(Stage stage, const QString &inputPath, const QString &outputPath);
+    
+    // Resolve the external tools now instead of in the first job, for
+    // long-lived callers such as the daemon. Returns false if pdflatex is
+    // missing.
+    bool warmUp();
+    
+    // Use this pdflatex instead of looking one up, for callers that have
+    // already resolved it for many creators
+    void setPdflatexPath(const QString &path) { m_pdflatexPath = path; }
+    
+    // Publish finished sheets incrementally into "<output>.parts/" while
+    // later sheets are still being composed (see sheetsReady). The parts
+    // outlive the job, since a consumer may open them at any time; the
+    // next streaming job for the same output replaces them.
+    void setStreamingOutput(bool enabled) { m_streamingOutput = enabled; }
+    bool streamingOutput() const { return m_streamingOutput; }
+    
+    // Remove the parts a streaming job published for outputPath, once their
+    // consumer is done with them
+    static bool releaseStreamingParts(const QString &outputPath);
+    
+    // Optional in-process passes: image downsampling runs on the input
+    // before layout, the other passes on the final output
+    void setOptimizerOptions(const PdfOptimizer::Options &options) { m_optimizerOptions = options; }
+    const PdfOptimizer::Options &optimizerOptions() const { return m_optimizerOptions; }
+    
+    // Byte-for-byte reproducible output: document IDs and dates are pinned
+    // from a hash of the input and the options (or SOURCE_DATE_EPOCH)
+    void setReproducible(bool enabled) { m_reproducible = enabled; }
+    bool reproducible() const { return m_reproducible; }
+    
+    // Checkpoint the jobs that follow into journal under jobKey: stage
+    // intermediates go to a durable scratch directory and are recorded as
+    // each stage completes, and stages an earlier attempt completed are
+    // skipped. Pass nullptr to go back to throwaway scratch directories.
+    void setJournal(JobJournal *journal, const QString &jobKey);
 
 signals:
+    // Whole-job progress in percent, weighted by expected stage durations
     void progressChanged(int progress);
-    void processingComplete(bool success, const QString &message);
+    // Estimated time left (-1 while unknown) and the stage now running
+    void etaChanged(qint64 remainingMs, const QString &stage);
+    // Emitted once per job; report is the job's ResourceReport as JSON
+    void processingComplete(bool success, const QString &message, const QJsonObject &report);
+    // Sheets firstSheet..lastSheet (1-based, of sheetCount) are final in partPath
+    void sheetsReady(int firstSheet, int lastSheet, int sheetCount, const QString &partPath);
     
 private:
     // A4 dimensions in points (72 points per inch)
@@ -43,18 +114,160 @@ private:
     const double A6_WIDTH = A4_WIDTH / 2;
     const double A6_HEIGHT = A4_HEIGHT / 2;
     
+    // Grid of page slots on one side of a printed A4 sheet
+    struct SheetGrid {
+        int columns;
+        int rows;
+        bool landscape;
+    };
+    
+    // Run layout, one of the path-based entry points, on input in a scratch
+    // directory and copy its result into output
+    bool runInMemory(QByteArrayView input, QIODevice *output,
+                     const std::function<bool(const QString &, const QString &)> &layout);
+    
     // Helper methods to create a booklet
     bool arrangePages(const QString &inputPath, const QString &outputPath, bool startFromBeginning);
     
-    // Extract a page from a PDF to an image
+    // Append blank pages to the pageCount-page input up to totalPages,
+    // writing workDir/padded.pdf
+    bool padPages(const QString &inputPath, int pageCount, int totalPages,
+                  const QString &workDir, QString &paddedPdfPath);
+    
+    // Extract pageOrder from the input into workDir/reordered.pdf
+    bool reorderPages(const QString &inputPath, const QList<int> &pageOrder,
+                      const QString &workDir, QString &reorderedPdf);
+    
+    // Saddle-stitch page order for a booklet of totalPages (a multiple of 4)
+    QList<int> bookletPageOrder(int totalPages, bool startFromBeginning) const;
+    
+    // Shared sheet layout kernel used by every 2-up and 4-up mode.
+    // pageOrder lists 1-based source pages slot by slot (0 = blank slot);
+    // all sheets are emitted by a single pdflatex pass over the input.
+    bool layoutSheets(const QString &inputPath, const QString &outputPath,
+                      const QList<int> &pageOrder, const SheetGrid &grid,
+                      const QString &successMessage);
+    
+    // Compile pageList (whole sheets) into workDir/layout.pdf with pdflatex
+    bool compileSheets(const QString &workDir, const QString &inputPath,
+                       const QStringList &pageList, const SheetGrid &grid,
+                       QString &pdfPath, QString &error);
+    
+    // Like compileSheets, but a large layout is split into sheet ranges
+    // compiled as tasks on the shared TaskScheduler and stitched with qpdf
+    bool compileSheetsInTasks(const QString &workDir, const QString &inputPath,
+                              const QStringList &pageList, const SheetGrid &grid,
+                              QString &pdfPath, QString &error);
+    
+    // Sheets per compile task; BOOKLET_SHEETS_PER_TASK, 0 turns splitting off
+    static int sheetsPerTask();
+    // True if a layout of sheetCount sheets is worth splitting into tasks
+    static bool compilesInTasks(int sheetCount);
+    
+    // Page count via qpdf --show-npages, or -1 with error set
+    int pageCountOf(const QString &pdfPath, QString &error);
+    
+    // Locate pdflatex once and cache the result
+    QString findPdflatex();
+    QString m_pdflatexPath;
+    
+    bool m_streamingOutput = false;
+    PdfOptimizer::Options m_optimizerOptions;
+    
+    bool m_reproducible = false;
+    QByteArray m_reproducibleId;
+    qint64 m_reproducibleEpoch = 0;
+    
+    // Derive m_reproducibleId and m_reproducibleEpoch for one layout job
+    void pinReproducibleFields(const QString &inputPath, const QStringList &pageList,
+                               const SheetGrid &grid);
+    
+    // Extract a page (1-based, like qpdf page numbers) from a PDF to an image
     QImage renderPage(const QString &pdfPath, int pageNum);
     
     // Create a combined page with two source pages side by side
     bool createCombinedPage(const QString &inputPath, const QString &outputPath, 
                           const QList<int> &pageOrder);
     
-    // Log progress update
-    void logProgress(int current, int total);
+    // Compact qpdf page range ("8,1-2,7-6,...") for a page order
+    static QString compactPageRanges(const QList<int> &pageOrder);
+    
+    // Write a qpdf job JSON file that concatenates (file, range) page specs into outputPath
+    bool writeQpdfJobFile(const QString &jobPath,
+                          const QList<QPair<QString, QString>> &pageSpecs,
+                          const QString &outputPath, QString &error);
+    
+    // Marks a public entry point. Jobs may nest (createBooklet ends in
+    // create4UpFor2Booklets); the outermost scope owns the resource report
+    // and emits processingComplete when it closes.
+    class JobScope {
+    public:
+        explicit JobScope(QPDFBookletCreator *creator);
+        ~JobScope();
+    private:
+        QPDFBookletCreator *m_creator;
+    };
+    
+    int m_jobDepth = 0;
+    bool m_jobCompleted = false;
+    bool m_jobSucceeded = false;
+    QString m_jobMessage;
+    ResourceReport m_report;
+    
+    // Tail of the last tool's stdout and stderr, filled by runTool
+    OutputRing m_toolStdout;
+    OutputRing m_toolStderr;
+    
+    // Record the job result (first call wins)
+    void completeJob(bool success, const QString &message);
+    // Finalize the report, log it and emit processingComplete
+    void finishJob();
+    
+    // Start a tool for one pipeline stage and wait for it, accounting its CPU
+    // time and peak RSS to the current job. The start waits for a slot from
+    // the ProcessGovernor and goes through the SpawnHelper when it runs.
+    // A StageWatchdog sized from pages
+    // and inputBytes kills the child if it overruns its deadline or stops
+    // making CPU progress. Its output is drained into
+    // m_toolStdout/m_toolStderr as it runs, so only a bounded tail is kept.
+    // Returns false on start failure, deadline or stall, like
+    // QProcess::waitForFinished.
+    bool runTool(ToolProcess &process, const QString &program,
+                 const QStringList &args, const QString &stage,
+                 int pages = 0, qint64 inputBytes = 0);
+    // Job the ProcessGovernor queues this creator's children under; 0 means
+    // the creator itself. Sheet-range tasks share their parent's.
+    quintptr m_governorJob = 0;
+    // Why the last runTool failed: the watchdog's verdict if it intervened,
+    // otherwise the process error
+    QString toolError(const ToolProcess &process) const;
+    QString m_toolFailure;
+    
+    // Resume support (see setJournal)
+    JobJournal *m_journal = nullptr;
+    QString m_journalKey;
+    
+    // Durable scratch path for one entry point's intermediates, or empty
+    // (temporary scratch) without a journal
+    QString durableScratch(const QString &name) const;
+    // Intermediate of a stage completed by an earlier attempt, or empty.
+    // A reused stage is dropped from the progress plan.
+    QString resumeArtifact(const QString &stage);
+    // Record that stage completed, leaving artifactPath
+    void checkpoint(const QString &stage, const QString &artifactPath);
+    
+    // Estimates progress and time left for the current job
+    ProgressEstimator m_progress;
+    int m_lastProgress = -1;
+    QElapsedTimer m_progressTimer;
+    
+    // Weight the layout stages of a job with slotCount slots into the
+    // progress plan, before any of them runs
+    void planLayout(int slotCount, const SheetGrid &grid, qint64 inputBytes);
+    
+    // Emit progressChanged when the percentage moves and etaChanged at most
+    // twice a second
+    void logProgress();
 };
 
 #endif // PDFBOOKLETCREATOR_H
@@ -0,0 +1,807 @@
+#include "pdfoptimizer.h"
+#include "taskscheduler.h"
+#include <QBuffer>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
+#include <QImage>
+#include <QImageWriter>
+#include <QLineF>
+#include <QReadWriteLock>
+#include <QTransform>
+#include <map>
+#include <stdexcept>
+#include <set>
+#include <qpdf/Buffer.hh>
+#include <qpdf/Pl_Flate.hh>
+#include <qpdf/QPDF.hh>
+#include <qpdf/QPDFObjectHandle.hh>
+#include <qpdf/QPDFPageDocumentHelper.hh>
+#include <qpdf/QPDFPageObjectHelper.hh>
+#include <qpdf/QPDFWriter.hh>
+
+namespace {
+
+typedef std::map<QPDFObjGen, QPDFObjectHandle> ReplacementMap;
+
+// Collect the streams used as [/ICCBased stream] colour spaces. Other
+// streams carry /N too (object streams, for one), so a profile is only
+// recognised by how it is referenced.
+void collectIccProfiles(QPDFObjectHandle object, std::set<QPDFObjGen> &profiles)
+{
+    if (object.isStream()) {
+        collectIccProfiles(object.getDict(), profiles);
+        return;
+    }
+    
+    if (object.isDictionary()) {
+        for (const std::string &key : object.getKeys()) {
+            QPDFObjectHandle value = object.getKey(key);
+            if (!value.isIndirect()) {
+                collectIccProfiles(value, profiles);
+            }
+        }
+    } else if (object.isArray()) {
+        int count = object.getArrayNItems();
+        if (count == 2 && object.getArrayItem(0).isNameAndEquals("/ICCBased")
+            && object.getArrayItem(1).isStream()) {
+            profiles.insert(object.getArrayItem(1).getObjGen());
+        }
+        for (int i = 0; i < count; ++i) {
+            QPDFObjectHandle value = object.getArrayItem(i);
+            if (!value.isIndirect()) {
+                collectIccProfiles(value, profiles);
+            }
+        }
+    }
+}
+
+// Kind of shared resource an indirect object is, or empty if it is not one
+// we merge. Dictionaries are only merged after the streams they use.
+QByteArray resourceKind(QPDFObjectHandle &object, const std::set<QPDFObjGen> &iccProfiles)
+{
+    if (object.isStream()) {
+        QPDFObjectHandle dict = object.getDict();
+        if (dict.getKey("/Subtype").isNameAndEquals("/Image")) {
+            return "image";
+        }
+        // Embedded font programs carry /Length1 (Type 1, TrueType) or a
+        // font-specific /Subtype (CFF, OpenType)
+        if (dict.hasKey("/Length1")
+            || dict.getKey("/Subtype").isNameAndEquals("/Type1C")
+            || dict.getKey("/Subtype").isNameAndEquals("/CIDFontType0C")
+            || dict.getKey("/Subtype").isNameAndEquals("/OpenType")) {
+            return "fontfile";
+        }
+        if (iccProfiles.count(object.getObjGen())) {
+            return "icc";
+        }
+        return QByteArray();
+    }
+    
+    if (object.isDictionary()) {
+        QPDFObjectHandle type = object.getKey("/Type");
+        if (type.isNameAndEquals("/FontDescriptor")) {
+            return "fontdescriptor";
+        }
+        if (type.isNameAndEquals("/Font")) {
+            return "font";
+        }
+    }
+    
+    return QByteArray();
+}
+
+// Content hash of an object: its dictionary (without /Length, which may be
+// indirect) plus, for streams, the raw encoded data
+QByteArray contentKey(QPDFObjectHandle &object, const QByteArray &kind)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(kind);
+    
+    if (object.isStream()) {
+        QPDFObjectHandle dict = object.getDict().shallowCopy();
+        dict.removeKey("/Length");
+        std::string unparsed = dict.unparse();
+        hash.addData(QByteArray::fromStdString(unparsed));
+        
+        std::shared_ptr<Buffer> data = object.getRawStreamData();
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(data->getBuffer()),
+                                             static_cast<int>(data->getSize())));
+    } else {
+        std::string unparsed = object.unparse();
+        hash.addData(QByteArray::fromStdString(unparsed));
+    }
+    
+    return hash.result();
+}
+
+// Point every reference to a merged duplicate at its canonical object
+void rewriteReferences(QPDFObjectHandle object, const ReplacementMap &replacements)
+{
+    if (object.isStream()) {
+        rewriteReferences(object.getDict(), replacements);
+        return;
+    }
+    
+    if (object.isDictionary()) {
+        for (const std::string &key : object.getKeys()) {
+            QPDFObjectHandle value = object.getKey(key);
+            if (value.isIndirect()) {
+                auto it = replacements.find(value.getObjGen());
+                if (it != replacements.end()) {
+                    object.replaceKey(key, it->second);
+                }
+            } else {
+                rewriteReferences(value, replacements);
+            }
+        }
+    } else if (object.isArray()) {
+        int count = object.getArrayNItems();
+        for (int i = 0; i < count; ++i) {
+            QPDFObjectHandle value = object.getArrayItem(i);
+            if (value.isIndirect()) {
+                auto it = replacements.find(value.getObjGen());
+                if (it != replacements.end()) {
+                    object.setArrayItem(i, it->second);
+                }
+            } else {
+                rewriteReferences(value, replacements);
+            }
+        }
+    }
+}
+
+// One merge pass over the given kinds; returns the number of objects merged
+int mergeDuplicates(QPDF &pdf, const QList<QByteArray> &kinds)
+{
+    QHash<QByteArray, QPDFObjectHandle> canonical;
+    ReplacementMap replacements;
+    
+    std::vector<QPDFObjectHandle> objects = pdf.getAllObjects();
+    std::set<QPDFObjGen> iccProfiles;
+    if (kinds.contains("icc")) {
+        for (QPDFObjectHandle &object : objects) {
+            collectIccProfiles(object, iccProfiles);
+        }
+    }
+    
+    for (QPDFObjectHandle &object : objects) {
+        QByteArray kind = resourceKind(object, iccProfiles);
+        if (kind.isEmpty() || !kinds.contains(kind)) {
+            continue;
+        }
+        
+        QByteArray key = contentKey(object, kind);
+        auto it = canonical.find(key);
+        if (it == canonical.end()) {
+            canonical.insert(key, object);
+        } else {
+            replacements[object.getObjGen()] = it.value();
+        }
+    }
+    
+    if (replacements.empty()) {
+        return 0;
+    }
+    
+    // Duplicates become unreachable once nothing refers to them, and
+    // QPDFWriter only writes objects reachable from the trailer
+    for (QPDFObjectHandle &object : pdf.getAllObjects()) {
+        rewriteReferences(object, replacements);
+    }
+    rewriteReferences(pdf.getTrailer(), replacements);
+    
+    return static_cast<int>(replacements.size());
+}
+
+void deduplicateResources(QPDF &pdf)
+{
+    // Streams first; merged streams can make their font descriptors
+    // identical, which in turn can make the font dictionaries identical
+    int merged = 0;
+    for (int pass = 0; pass < 4; ++pass) {
+        int passMerged = mergeDuplicates(pdf, {"image", "fontfile", "icc"});
+        merged += passMerged;
+        if (passMerged == 0) {
+            break;
+        }
+    }
+    merged += mergeDuplicates(pdf, {"fontdescriptor"});
+    merged += mergeDuplicates(pdf, {"font"});
+    
+    qDebug() << "Resource deduplication merged" << merged << "objects";
+}
+
+// Only resample when an image is clearly over the target; re-encoding an
+// image that is just above it costs more than it saves
+const double DOWNSAMPLE_SLACK = 1.1;
+
+// Form XObjects nested deeper than this are not followed
+const int MAX_FORM_DEPTH = 12;
+
+// Largest size (in inches, as printed) an image is drawn at
+struct ImagePlacement {
+    QPDFObjectHandle image;
+    QSizeF inches;
+    bool unknown = false;       // also drawn somewhere we could not follow
+};
+
+typedef std::map<QPDFObjGen, ImagePlacement> PlacementMap;
+
+// Tracks the CTM through q/Q/cm in a content stream and records the size
+// every image XObject is drawn at, descending into form XObjects. Images
+// may be clipped or extend past the page, so only the CTM tells how large
+// they are really printed.
+class PlacementWalker : public QPDFObjectHandle::ParserCallbacks
+{
+public:
+    PlacementWalker(const QTransform &ctm, QPDFObjectHandle resources,
+                    PlacementMap &placements, int depth = 0)
+        : m_ctm(ctm), m_resources(resources), m_placements(placements), m_depth(depth)
+    {
+    }
+    
+    void handleObject(QPDFObjectHandle object) override
+    {
+        if (!object.isOperator()) {
+            m_operands.push_back(object);
+            return;
+        }
+        
+        std::string op = object.getOperator();
+        if (op == "q") {
+            m_stack.push_back(m_ctm);
+        } else if (op == "Q") {
+            if (!m_stack.empty()) {
+                m_ctm = m_stack.back();
+                m_stack.pop_back();
+            }
+        } else if (op == "cm" && m_operands.size() == 6) {
+            QTransform matrix;
+            if (toTransform(m_operands, matrix)) {
+                m_ctm = matrix * m_ctm;
+            }
+        } else if (op == "Do" && m_operands.size() == 1 && m_operands[0].isName()) {
+            drawXObject(m_operands[0].getName());
+        }
+        m_operands.clear();
+    }
+    
+    void handleEOF() override
+    {
+    }
+    
+    static bool toTransform(const std::vector<QPDFObjectHandle> &values, QTransform &matrix)
+    {
+        double m[6];
+        for (int i = 0; i < 6; ++i) {
+            if (!values[i].isNumber()) {
+                return false;
+            }
+            m[i] = values[i].getNumericValue();
+        }
+        matrix = QTransform(m[0], m[1], m[2], m[3], m[4], m[5]);
+        return true;
+    }
+    
+private:
+    void drawXObject(const std::string &name)
+    {
+        QPDFObjectHandle xobjects = m_resources.isDictionary() ? m_resources.getKey("/XObject")
+                                                               : QPDFObjectHandle::newNull();
+        QPDFObjectHandle xobject = xobjects.isDictionary() ? xobjects.getKey(name)
+                                                           : QPDFObjectHandle::newNull();
+        if (!xobject.isStream()) {
+            return;
+        }
+        
+        QPDFObjectHandle dict = xobject.getDict();
+        if (dict.getKey("/Subtype").isNameAndEquals("/Image")) {
+            // Images are drawn into the unit square of the CTM
+            QPointF origin = m_ctm.map(QPointF(0, 0));
+            QSizeF inches(QLineF(origin, m_ctm.map(QPointF(1, 0))).length() / 72.0,
+                          QLineF(origin, m_ctm.map(QPointF(0, 1))).length() / 72.0);
+            ImagePlacement &placement = m_placements[xobject.getObjGen()];
+            placement.image = xobject;
+            placement.inches = placement.inches.expandedTo(inches);
+        } else if (dict.getKey("/Subtype").isNameAndEquals("/Form")) {
+            if (m_depth >= MAX_FORM_DEPTH) {
+                throw std::runtime_error("form XObjects nested too deeply");
+            }
+            
+            QTransform ctm = m_ctm;
+            QPDFObjectHandle matrix = dict.getKey("/Matrix");
+            if (matrix.isArray() && matrix.getArrayNItems() == 6) {
+                QTransform formMatrix;
+                if (toTransform(matrix.getArrayAsVector(), formMatrix)) {
+                    ctm = formMatrix * m_ctm;
+                }
+            }
+            
+            QPDFObjectHandle resources = dict.getKey("/Resources");
+            PlacementWalker form(ctm, resources.isDictionary() ? resources : m_resources,
+                                 m_placements, m_depth + 1);
+            xobject.parseAsContents(&form);
+        }
+    }
+    
+    QTransform m_ctm;
+    std::vector<QTransform> m_stack;
+    std::vector<QPDFObjectHandle> m_operands;
+    QPDFObjectHandle m_resources;
+    PlacementMap &m_placements;
+    int m_depth;
+};
+
+// Factor a page is scaled by when the layout fits it into a slot of the
+// given size (in points), honouring /Rotate; 1 without a slot
+double slotScale(QPDFPageObjectHelper &page, const QSizeF &slot)
+{
+    if (slot.isEmpty()) {
+        return 1.0;
+    }
+    
+    QPDFObjectHandle::Rectangle box = page.getCropBox().getArrayAsRectangle();
+    QSizeF pageSize(qAbs(box.urx - box.llx), qAbs(box.ury - box.lly));
+    QPDFObjectHandle rotate = page.getAttribute("/Rotate", false);
+    if (rotate.isInteger() && (rotate.getIntValue() / 90) % 2 != 0) {
+        pageSize.transpose();
+    }
+    if (pageSize.isEmpty()) {
+        return 1.0;
+    }
+    return qMin(slot.width() / pageSize.width(), slot.height() / pageSize.height());
+}
+
+// One image to resample, detached from qpdf so it can be processed on any thread
+struct ResampleJob {
+    QPDFObjectHandle image;     // only touched on the calling thread
+    QByteArray data;            // encoded JPEG or raw decoded samples
+    bool isJpeg = false;
+    int components = 0;
+    int width = 0;
+    int height = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    int jpegQuality = 85;
+    QByteArray result;
+    
+    // Decoded soft mask, resampled to the same target size (optional)
+    QByteArray maskData;
+    int maskWidth = 0;
+    int maskHeight = 0;
+    QByteArray maskResult;
+    
+    bool ok = false;
+};
+
+QByteArray streamBytes(const std::shared_ptr<Buffer> &data)
+{
+    return QByteArray(reinterpret_cast<const char *>(data->getBuffer()),
+                      static_cast<int>(data->getSize()));
+}
+
+// Resample raw 8-bit samples with the given component count
+bool resampleRaw(const QByteArray &data, int width, int height, int components,
+                 int targetWidth, int targetHeight, QByteArray &result)
+{
+    QImage::Format format = components == 3 ? QImage::Format_RGB888 : QImage::Format_Grayscale8;
+    int bytesPerLine = width * components;
+    if (data.size() < qint64(bytesPerLine) * height) {
+        return false;
+    }
+    
+    QImage image(reinterpret_cast<const uchar *>(data.constData()), width, height, bytesPerLine, format);
+    QImage scaled = image.scaled(targetWidth, targetHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    
+    result.clear();
+    result.reserve(targetWidth * targetHeight * components);
+    for (int y = 0; y < scaled.height(); ++y) {
+        result.append(reinterpret_cast<const char *>(scaled.constScanLine(y)), targetWidth * components);
+    }
+    return true;
+}
+
+// Number of colour components of an image we know how to resample, or 0
+int supportedComponents(QPDFObjectHandle dict)
+{
+    if (dict.getKey("/ImageMask").isBool() && dict.getKey("/ImageMask").getBoolValue()) {
+        return 0;
+    }
+    if (dict.hasKey("/Mask") || dict.hasKey("/Decode")) {
+        return 0;
+    }
+    if (!dict.getKey("/BitsPerComponent").isInteger()
+        || dict.getKey("/BitsPerComponent").getIntValue() != 8) {
+        return 0;
+    }
+    
+    QPDFObjectHandle colorSpace = dict.getKey("/ColorSpace");
+    if (colorSpace.isNameAndEquals("/DeviceRGB")) {
+        return 3;
+    }
+    if (colorSpace.isNameAndEquals("/DeviceGray")) {
+        return 1;
+    }
+    if (colorSpace.isArray() && colorSpace.getArrayNItems() == 2
+        && colorSpace.getArrayItem(0).isNameAndEquals("/ICCBased")) {
+        QPDFObjectHandle components = colorSpace.getArrayItem(1).getDict().getKey("/N");
+        if (components.isInteger()
+            && (components.getIntValue() == 1 || components.getIntValue() == 3)) {
+            return static_cast<int>(components.getIntValue());
+        }
+    }
+    return 0;
+}
+
+// Decode, resample and re-encode one image. Runs on a pool thread and only
+// uses Qt image code; QImage smooth scaling uses the SSE/AVX2/NEON paths of
+// Qt's image scaler.
+void resample(ResampleJob &job)
+{
+    if (!job.maskData.isEmpty()
+        && !resampleRaw(job.maskData, job.maskWidth, job.maskHeight, 1,
+                        job.targetWidth, job.targetHeight, job.maskResult)) {
+        return;
+    }
+    
+    if (!job.isJpeg) {
+        job.ok = resampleRaw(job.data, job.width, job.height, job.components,
+                             job.targetWidth, job.targetHeight, job.result);
+        return;
+    }
+    
+    QImage image = QImage::fromData(job.data, "JPEG");
+    if (image.isNull()) {
+        return;
+    }
+    
+    QImage scaled = image.scaled(job.targetWidth, job.targetHeight,
+                                 Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    scaled = scaled.convertToFormat(job.components == 3 ? QImage::Format_RGB888 : QImage::Format_Grayscale8);
+    
+    QBuffer buffer(&job.result);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "JPEG");
+    writer.setQuality(job.jpegQuality);
+    job.ok = writer.write(scaled);
+}
+
+void downsampleImages(QPDF &pdf, const PdfOptimizer::Options &options)
+{
+    // Largest printed size of each image: its placement CTM on the page,
+    // times the scale the layout applies when fitting the page into its
+    // sheet slot. Pixels / printed size is then the resolution the image
+    // really prints at, even when it is clipped or the page is scaled up.
+    PlacementMap images;
+    
+    for (QPDFPageObjectHelper &page : QPDFPageDocumentHelper(pdf).getAllPages()) {
+        double scale = slotScale(page, options.placementSlot);
+        QPDFObjectHandle resources = page.getAttribute("/Resources", false);
+        PlacementWalker walker(QTransform::fromScale(scale, scale), resources, images);
+        try {
+            page.parseContents(&walker);
+        } catch (std::exception &e) {
+            // Images on a page we cannot follow are left at full resolution
+            qDebug() << "Cannot trace image placements:" << e.what();
+            page.forEachImage(true, [&](QPDFObjectHandle &image, QPDFObjectHandle &, std::string const &) {
+                ImagePlacement &placement = images[image.getObjGen()];
+                placement.image = image;
+                placement.unknown = true;
+            });
+        }
+    }
+    
+    std::vector<ResampleJob> jobs;
+    for (auto &entry : images) {
+        QPDFObjectHandle image = entry.second.image;
+        QSizeF inches = entry.second.inches;
+        QPDFObjectHandle dict = image.getDict();
+        
+        int width = static_cast<int>(dict.getKey("/Width").getIntValue());
+        int height = static_cast<int>(dict.getKey("/Height").getIntValue());
+        if (entry.second.unknown || width <= 0 || height <= 0 || inches.isEmpty()) {
+            continue;
+        }
+        
+        double dpi = qMin(width / inches.width(), height / inches.height());
+        if (dpi <= options.downsampleDpi * DOWNSAMPLE_SLACK) {
+            continue;
+        }
+        
+        int components = supportedComponents(dict);
+        if (components == 0) {
+            continue;
+        }
+        
+        QPDFObjectHandle filter = dict.getKey("/Filter");
+        if (filter.isArray() && filter.getArrayNItems() == 1) {
+            filter = filter.getArrayItem(0);
+        }
+        
+        ResampleJob job;
+        job.image = image;
+        job.components = components;
+        job.width = width;
+        job.height = height;
+        job.jpegQuality = options.jpegQuality;
+        double scale = options.downsampleDpi / dpi;
+        job.targetWidth = qMax(1, qRound(width * scale));
+        job.targetHeight = qMax(1, qRound(height * scale));
+        
+        try {
+            if (filter.isNameAndEquals("/DCTDecode")) {
+                job.isJpeg = true;
+                job.data = streamBytes(image.getRawStreamData());
+            } else {
+                job.data = streamBytes(image.getStreamData(qpdf_dl_generalized));
+            }
+            
+            // A soft mask must keep the size of the image it masks
+            QPDFObjectHandle softMask = dict.getKey("/SMask");
+            if (softMask.isStream()) {
+                QPDFObjectHandle maskDict = softMask.getDict();
+                if (maskDict.getKey("/BitsPerComponent").getIntValue() != 8) {
+                    continue;
+                }
+                job.maskWidth = static_cast<int>(maskDict.getKey("/Width").getIntValue());
+                job.maskHeight = static_cast<int>(maskDict.getKey("/Height").getIntValue());
+                job.maskData = streamBytes(softMask.getStreamData(qpdf_dl_generalized));
+            }
+        } catch (std::exception &e) {
+            // Filters we cannot decode are passed through untouched
+            qDebug() << "Skipping image" << image.getObjectID() << ":" << e.what();
+            continue;
+        }
+        
+        jobs.push_back(job);
+    }
+    
+    if (jobs.empty()) {
+        qDebug() << "No images above" << options.downsampleDpi << "DPI";
+        return;
+    }
+    
+    qDebug() << "Downsampling" << jobs.size() << "images to" << options.downsampleDpi << "DPI";
+    TaskScheduler::instance().map(jobs, resample);
+    
+    for (ResampleJob &job : jobs) {
+        if (!job.ok) {
+            continue;
+        }
+        
+        QPDFObjectHandle dict = job.image.getDict();
+        if (job.isJpeg) {
+            job.image.replaceStreamData(job.result.toStdString(),
+                                        QPDFObjectHandle::newName("/DCTDecode"),
+                                        QPDFObjectHandle::newNull());
+        } else {
+            // Left unfiltered here; QPDFWriter deflates it on write
+            job.image.replaceStreamData(job.result.toStdString(),
+                                        QPDFObjectHandle::newNull(),
+                                        QPDFObjectHandle::newNull());
+        }
+        dict.replaceKey("/Width", QPDFObjectHandle::newInteger(job.targetWidth));
+        dict.replaceKey("/Height", QPDFObjectHandle::newInteger(job.targetHeight));
+        
+        if (!job.maskResult.isEmpty()) {
+            QPDFObjectHandle softMask = dict.getKey("/SMask");
+            softMask.replaceStreamData(job.maskResult.toStdString(),
+                                       QPDFObjectHandle::newNull(),
+                                       QPDFObjectHandle::newNull());
+            softMask.getDict().replaceKey("/Width", QPDFObjectHandle::newInteger(job.targetWidth));
+            softMask.getDict().replaceKey("/Height", QPDFObjectHandle::newInteger(job.targetHeight));
+        }
+    }
+}
+
+// Decoded bytes deflated per batch, so only one batch of a large document
+// is held in memory at a time
+const qint64 DEFLATE_BATCH_BYTES = 64 * 1024 * 1024;
+
+// A stream to deflate, detached from qpdf so it can be compressed on any thread
+struct DeflateJob {
+    QPDFObjectHandle stream;    // only touched on the calling thread
+    QByteArray data;
+    int level = -1;
+    QByteArray result;
+};
+
+// True if the stream only uses filters qpdf can fully decode and that
+// are worth replacing with our own Flate encoding
+bool isRecompressible(QPDFObjectHandle &stream)
+{
+    QPDFObjectHandle dict = stream.getDict();
+    QPDFObjectHandle type = dict.getKey("/Type");
+    if (type.isNameAndEquals("/XRef") || type.isNameAndEquals("/ObjStm")
+        || type.isNameAndEquals("/Metadata")) {
+        return false;
+    }
+    
+    QPDFObjectHandle filter = dict.getKey("/Filter");
+    if (filter.isNull()) {
+        return true;
+    }
+    if (filter.isArray() && filter.getArrayNItems() == 1) {
+        filter = filter.getArrayItem(0);
+    }
+    if (!filter.isNameAndEquals("/FlateDecode")) {
+        return false;
+    }
+    
+    // A predictor usually shrinks images far more than a higher level
+    // would, and the plain deflate below would drop it
+    QPDFObjectHandle parms = dict.getKey("/DecodeParms");
+    if (parms.isArray() && parms.getArrayNItems() == 1) {
+        parms = parms.getArrayItem(0);
+    }
+    if (parms.isDictionary()) {
+        QPDFObjectHandle predictor = parms.getKey("/Predictor");
+        if (predictor.isInteger() && predictor.getIntValue() > 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void deflate(DeflateJob &job)
+{
+    // qCompress produces a zlib stream behind a 4-byte length prefix
+    job.result = qCompress(job.data, job.level).mid(4);
+}
+
+// Deflate the batch on the thread pool and hand the results back to qpdf
+void deflateBatch(std::vector<DeflateJob> &jobs)
+{
+    TaskScheduler::instance().map(jobs, deflate);
+    for (DeflateJob &job : jobs) {
+        job.stream.replaceStreamData(job.result.toStdString(),
+                                     QPDFObjectHandle::newName("/FlateDecode"),
+                                     QPDFObjectHandle::newNull());
+    }
+    jobs.clear();
+}
+
+// Deflate every recompressible stream on the thread pool so the writer only
+// has to copy the encoded data. Streams are decoded and compressed in
+// batches of DEFLATE_BATCH_BYTES.
+void compressStreamsInParallel(QPDF &pdf, int level)
+{
+    std::vector<DeflateJob> jobs;
+    qint64 batchBytes = 0;
+    int deflated = 0;
+    for (QPDFObjectHandle &object : pdf.getAllObjects()) {
+        if (!object.isStream() || !isRecompressible(object)) {
+            continue;
+        }
+        
+        DeflateJob job;
+        job.stream = object;
+        job.level = level;
+        try {
+            job.data = streamBytes(object.getStreamData(qpdf_dl_generalized));
+        } catch (std::exception &e) {
+            qDebug() << "Leaving stream" << object.getObjectID() << "as is:" << e.what();
+            continue;
+        }
+        batchBytes += job.data.size();
+        jobs.push_back(std::move(job));
+        
+        if (batchBytes >= DEFLATE_BATCH_BYTES) {
+            deflated += int(jobs.size());
+            deflateBatch(jobs);
+            batchBytes = 0;
+        }
+    }
+    deflated += int(jobs.size());
+    deflateBatch(jobs);
+    
+    qDebug() << "Deflated" << deflated << "streams in parallel";
+}
+
+// Pl_Flate::setCompressionLevel is process-global, and qpdf has no getter
+// for it. Every write holds this lock: writes at the zlib default share
+// it, while a write at a custom level holds it exclusively and restores
+// the default before releasing it, so concurrent jobs never see another
+// job's level.
+QReadWriteLock flateLevelLock;
+
+class FlateLevelScope
+{
+public:
+    explicit FlateLevelScope(int level)
+        : m_custom(level >= 0)
+    {
+        if (m_custom) {
+            flateLevelLock.lockForWrite();
+            Pl_Flate::setCompressionLevel(level);
+        } else {
+            flateLevelLock.lockForRead();
+        }
+    }
+    
+    ~FlateLevelScope()
+    {
+        if (m_custom) {
+            Pl_Flate::setCompressionLevel(-1);
+        }
+        flateLevelLock.unlock();
+    }
+    
+private:
+    bool m_custom;
+};
+
+// Replace the /Info dates with the pinned epoch
+void pinDocumentDates(QPDF &pdf, qint64 sourceDateEpoch)
+{
+    QPDFObjectHandle info = pdf.getTrailer().getKey("/Info");
+    if (!info.isDictionary()) {
+        return;
+    }
+    
+    QString date = QDateTime::fromSecsSinceEpoch(sourceDateEpoch).toUTC()
+                       .toString("'D:'yyyyMMddHHmmss'Z'");
+    QPDFObjectHandle pdfDate = QPDFObjectHandle::newString(date.toStdString());
+    if (info.hasKey("/CreationDate")) {
+        info.replaceKey("/CreationDate", pdfDate);
+    }
+    if (info.hasKey("/ModDate")) {
+        info.replaceKey("/ModDate", pdfDate);
+    }
+}
+
+} // namespace
+
+bool PdfOptimizer::optimize(const QString &inputPath, const QString &outputPath,
+                            const Options &options, QString &error)
+{
+    qDebug() << "=== Optimizing PDF ===";
+    qDebug() << "Input path:" << inputPath;
+    qDebug() << "Output path:" << outputPath;
+    
+    try {
+        QPDF pdf;
+        pdf.processFile(inputPath.toLocal8Bit().constData());
+        
+        if (options.downsampleDpi > 0) {
+            downsampleImages(pdf, options);
+        }
+        
+        if (options.deduplicateResources) {
+            deduplicateResources(pdf);
+        }
+        
+        QPDFWriter writer(pdf, outputPath.toLocal8Bit().constData());
+        if (options.parallelCompression) {
+            compressStreamsInParallel(pdf, options.compressionLevel);
+            // Streams are already deflated; copy them as they are, but keep
+            // compression on for the object and xref streams qpdf generates
+            writer.setDecodeLevel(qpdf_dl_none);
+            writer.setRecompressFlate(false);
+        } else if (options.compressionLevel >= 0) {
+            writer.setRecompressFlate(true);
+        }
+        if (options.objectStreams) {
+            writer.setObjectStreamMode(qpdf_o_generate);
+        }
+        if (options.linearize) {
+            writer.setLinearization(true);
+        }
+        if (options.deterministic) {
+            pinDocumentDates(pdf, options.sourceDateEpoch);
+            writer.setDeterministicID(true);
+        }
+        
+        FlateLevelScope flateLevel(options.compressionLevel);
+        writer.write();
+    } catch (std::exception &e) {
+        error = QString("PDF optimization failed: %1").arg(e.what());
+        return false;
+    }
+    
+    return true;
+}
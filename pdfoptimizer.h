@@ -0,0 +1,53 @@
+#ifndef PDFOPTIMIZER_H
+#define PDFOPTIMIZER_H
+
+#include <QSizeF>
+#include <QString>
+
+// In-process optimization passes over a finished PDF, built on libqpdf.
+// The qpdf command line only concatenates and reorders pages; these passes
+// rewrite objects before the file is written.
+class PdfOptimizer
+{
+public:
+    struct Options {
+        // Merge byte-identical images, embedded font programs, ICC profiles
+        // and the font dictionaries that use them into shared objects
+        bool deduplicateResources = false;
+        
+        // Resample images whose effective resolution as printed exceeds
+        // this many DPI (0 = off); images under the target pass through
+        int downsampleDpi = 0;
+        
+        // Slot (in points) the following layout fits each page into, so the
+        // printed size accounts for pages scaled up or down onto the sheet.
+        // Empty = pages print at their own size.
+        QSizeF placementSlot;
+        
+        // JPEG quality used when re-encoding downsampled DCT images
+        int jpegQuality = 85;
+        
+        // Writer settings for the file produced by the pass
+        bool objectStreams = false;        // pack objects into object streams
+        int compressionLevel = -1;         // zlib level 1-9, -1 = zlib default
+        bool parallelCompression = false;  // deflate streams across all cores
+        bool linearize = false;            // fast first-page opening
+        
+        // Content-derived /ID and /Info dates pinned to sourceDateEpoch
+        bool deterministic = false;
+        qint64 sourceDateEpoch = 0;
+        
+        bool isEnabled() const
+        {
+            return deduplicateResources || downsampleDpi > 0 || objectStreams
+                || compressionLevel >= 0 || parallelCompression || linearize
+                || deterministic;
+        }
+    };
+    
+    // Read inputPath, apply the enabled passes and write outputPath
+    static bool optimize(const QString &inputPath, const QString &outputPath,
+                         const Options &options, QString &error);
+};
+
+#endif // PDFOPTIMIZER_H
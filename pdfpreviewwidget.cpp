@@ -1,12 +1,11 @@
 #include "pdfpreviewwidget.h"
+#include "rendererloader.h"
 #include <QDebug>
 #include <QPainter>
 #include <QFile>
 
-// Use PDFium for PDF rendering
-// Note: This is a simplified implementation - in a real app, you'd want to use the PDFium C API properly
-// For demonstration purposes, we're using a simple QImage-based approach
-// You would need to properly implement the PDFium integration in a real application
+// Pages are rendered by a backend plugin (see RendererLoader), loaded the
+// first time a PDF is previewed. Without one, a placeholder page is drawn.
 
 PDFPreviewWidget::PDFPreviewWidget(QWidget *parent)
     : QWidget(parent), m_currentPage(0), m_pageCount(0), m_scale(1.0), m_dpi(72)
@@ -30,13 +29,22 @@ bool PDFPreviewWidget::loadPDF(const QString &filePath)
     m_pdfPath = filePath;
     m_currentPage = 0;
     
-    // In a real implementation, you would:
-    // 1. Use PDFium to open the PDF
-    // 2. Get the page count
-    // 3. Set up the document for rendering
+    // The first preview loads the rendering backend and, with it, the
+    // backend's font and colour management
+    QString error;
+    m_renderer = RendererLoader::createRenderer(error);
+    if (m_renderer && !m_renderer->open(filePath, error)) {
+        qWarning() << "Cannot open PDF for preview:" << error;
+        m_renderer.reset();
+        return false;
+    }
     
-    // For this simplified version:
-    m_pageCount = 1; // Placeholder
+    if (m_renderer) {
+        m_pageCount = m_renderer->pageCount();
+    } else {
+        qDebug() << error << "- showing a placeholder";
+        m_pageCount = 1; // Placeholder
+    }
     
     // Render the first page
     renderPage();
@@ -48,6 +56,7 @@ bool PDFPreviewWidget::loadPDF(const QString &filePath)
 void PDFPreviewWidget::clearPreview()
 {
     m_pdfPath.clear();
+    m_renderer.reset();
     m_pageImage = QImage();
     m_currentPage = 0;
     m_pageCount = 0;
@@ -119,8 +128,19 @@ void PDFPreviewWidget::renderPage()
         return;
     }
     
-    // This is where you would use PDFium to render the page
-    // For this simplified implementation, we'll create a placeholder image
+    if (m_renderer) {
+        // Resolution that fills the widget width, within sane bounds
+        QSizeF pageSize = m_renderer->pageSize(m_currentPage);
+        double dpi = pageSize.width() > 0 ? width() * 72.0 / pageSize.width() : 72.0;
+        m_dpi = std::max(36, std::min(300, static_cast<int>(dpi)));
+        m_pageImage = m_renderer->renderPage(m_currentPage, m_dpi);
+        if (!m_pageImage.isNull()) {
+            return;
+        }
+        qWarning() << "Backend failed to render page" << m_currentPage + 1;
+    }
+    
+    // No backend: draw a placeholder page
     
     // Calculate DPI based on widget size to get a good quality preview
     m_dpi = std::max(72, std::min(300, width() / (int)(A4_WIDTH / 72)));
@@ -148,9 +168,4 @@ void PDFPreviewWidget::renderPage()
     // Draw A6 guides
     painter.setPen(QPen(Qt::lightGray, 2, Qt::DashLine));
     painter.drawLine(imgWidth/2, 0, imgWidth/2, imgHeight);
-    
-    // In a real implementation:
-    // 1. Use PDFium to render the specific page to a bitmap
-    // 2. Convert that bitmap to a QImage
-    // 3. Store the result in m_pageImage
 }
@@ -6,6 +6,9 @@
 #include <QPaintEvent>
 #include <QResizeEvent>
 #include <QImage>
+#include <memory>
+
+class PdfRenderer;
 
 class PDFPreviewWidget : public QWidget
 {
@@ -40,6 +43,10 @@ private:
     int m_pageCount;
     QImage m_pageImage;
     
+    // Backend renderer, created on the first loadPDF; null when no backend
+    // plugin is installed and a placeholder is drawn instead
+    std::unique_ptr<PdfRenderer> m_renderer;
+    
     // Target page size in points
     const double A4_WIDTH = 595.276;
     const double A4_HEIGHT = 841.89;
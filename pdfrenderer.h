@@ -0,0 +1,42 @@
+#ifndef PDFRENDERER_H
+#define PDFRENDERER_H
+
+#include <QImage>
+#include <QSizeF>
+#include <QString>
+#include <QtPlugin>
+
+// One open document in a rendering backend
+class PdfRenderer
+{
+public:
+    virtual ~PdfRenderer() = default;
+    
+    virtual bool open(const QString &filePath, QString &error) = 0;
+    virtual int pageCount() const = 0;
+    
+    // Size of a page (0-based) in points
+    virtual QSizeF pageSize(int pageIndex) const = 0;
+    
+    // Render a page (0-based) at the given resolution
+    virtual QImage renderPage(int pageIndex, double dpi) = 0;
+};
+
+// Entry point of a rendering backend plugin. Backends pull in large
+// libraries (poppler, its font and colour management), so they are only
+// loaded through RendererLoader when a page is first rendered.
+class PdfRendererFactory
+{
+public:
+    virtual ~PdfRendererFactory() = default;
+    
+    virtual QString backendName() const = 0;
+    
+    // New renderer owned by the caller
+    virtual PdfRenderer *createRenderer() = 0;
+};
+
+#define PdfRendererFactory_iid "com.yourcompany.A6BookletMaker.PdfRendererFactory/1.0"
+Q_DECLARE_INTERFACE(PdfRendererFactory, PdfRendererFactory_iid)
+
+#endif // PDFRENDERER_H
@@ -0,0 +1,36 @@
+# poppler.pro - poppler rendering backend for the preview
+#
+# Loaded by RendererLoader the first time a page is rendered; the main
+# application does not link poppler.
+#
+#   qmake poppler.pro && make
+
+QT       += core gui
+TEMPLATE = lib
+CONFIG  += plugin
+TARGET   = popplerrenderer
+
+DEFINES += QT_DEPRECATED_WARNINGS
+CONFIG += sdk_no_version_check
+
+macx {
+    INCLUDEPATH += /opt/homebrew/include/poppler/qt6
+    LIBS += -L/opt/homebrew/lib -lpoppler-qt6
+}
+
+unix:!macx {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += poppler-qt6
+}
+
+INCLUDEPATH += ../..
+
+# Next to the executable, where RendererLoader looks
+DESTDIR = ../../renderers
+
+SOURCES += \
+    popplerrenderer.cpp
+
+HEADERS += \
+    ../../pdfrenderer.h \
+    popplerrenderer.h
@@ -0,0 +1,107 @@
+#include "popplerrenderer.h"
+#include <QColorSpace>
+#include <QDebug>
+#include <QFile>
+#include <poppler-qt6.h>
+#include <mutex>
+
+namespace {
+
+// Shared by every document; set up when the first renderer is created
+struct RenderContext
+{
+    QColorSpace displaySpace;
+};
+
+RenderContext &renderContext()
+{
+    static RenderContext context;
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        // Display profile for converting rendered pages: the ICC file in
+        // BOOKLET_DISPLAY_ICC if given, sRGB otherwise
+        context.displaySpace = QColorSpace(QColorSpace::SRgb);
+        QString iccPath = qEnvironmentVariable("BOOKLET_DISPLAY_ICC");
+        if (!iccPath.isEmpty()) {
+            QFile icc(iccPath);
+            if (icc.open(QIODevice::ReadOnly)) {
+                QColorSpace profile = QColorSpace::fromIccProfile(icc.readAll());
+                if (profile.isValid()) {
+                    context.displaySpace = profile;
+                }
+            }
+        }
+        qDebug() << "Poppler renderer initialized, poppler" << Poppler::Version::string();
+    });
+    return context;
+}
+
+} // namespace
+
+PopplerRenderer::PopplerRenderer()
+{
+}
+
+PopplerRenderer::~PopplerRenderer()
+{
+}
+
+bool PopplerRenderer::open(const QString &filePath, QString &error)
+{
+    m_document = Poppler::Document::load(filePath);
+    if (!m_document || m_document->isLocked()) {
+        m_document.reset();
+        error = "poppler cannot open " + filePath;
+        return false;
+    }
+    
+    m_document->setRenderHint(Poppler::Document::Antialiasing);
+    m_document->setRenderHint(Poppler::Document::TextAntialiasing);
+    return true;
+}
+
+int PopplerRenderer::pageCount() const
+{
+    return m_document ? m_document->numPages() : 0;
+}
+
+QSizeF PopplerRenderer::pageSize(int pageIndex) const
+{
+    if (!m_document) {
+        return QSizeF();
+    }
+    std::unique_ptr<Poppler::Page> page = m_document->page(pageIndex);
+    return page ? page->pageSizeF() : QSizeF();
+}
+
+QImage PopplerRenderer::renderPage(int pageIndex, double dpi)
+{
+    if (!m_document) {
+        return QImage();
+    }
+    std::unique_ptr<Poppler::Page> page = m_document->page(pageIndex);
+    if (!page) {
+        return QImage();
+    }
+    
+    QImage image = page->renderToImage(dpi, dpi);
+    if (image.isNull()) {
+        return image;
+    }
+    
+    // poppler renders in sRGB
+    const QColorSpace &displaySpace = renderContext().displaySpace;
+    image.setColorSpace(QColorSpace(QColorSpace::SRgb));
+    if (displaySpace != image.colorSpace()) {
+        image.convertToColorSpace(displaySpace);
+    }
+    return image;
+}
+
+PdfRenderer *PopplerRendererFactory::createRenderer()
+{
+    // Loading the plugin only maps the library; shared state is set up here,
+    // the first time a page is actually wanted
+    renderContext();
+    return new PopplerRenderer();
+}
@@ -0,0 +1,39 @@
+#ifndef POPPLERRENDERER_H
+#define POPPLERRENDERER_H
+
+#include "pdfrenderer.h"
+#include <QObject>
+#include <memory>
+
+namespace Poppler {
+    class Document;
+}
+
+// Renders pages with poppler-qt6
+class PopplerRenderer : public PdfRenderer
+{
+public:
+    PopplerRenderer();
+    ~PopplerRenderer() override;
+    
+    bool open(const QString &filePath, QString &error) override;
+    int pageCount() const override;
+    QSizeF pageSize(int pageIndex) const override;
+    QImage renderPage(int pageIndex, double dpi) override;
+
+private:
+    std::unique_ptr<Poppler::Document> m_document;
+};
+
+class PopplerRendererFactory : public QObject, public PdfRendererFactory
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID PdfRendererFactory_iid)
+    Q_INTERFACES(PdfRendererFactory)
+
+public:
+    QString backendName() const override { return "poppler"; }
+    PdfRenderer *createRenderer() override;
+};
+
+#endif // POPPLERRENDERER_H
@@ -0,0 +1,258 @@
+#include "processgovernor.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSet>
+#include <QSettings>
+#include <QThread>
+#include <unistd.h>
+
+namespace {
+
+// Peak RSS assumed for a tool before any run of it was measured
+struct ToolMemory
+{
+    const char *tool;
+    qint64 rssKb;
+};
+
+const ToolMemory DEFAULT_MEMORY[] = {
+    { "pdflatex", 250 * 1024 },
+    { "qpdf",      80 * 1024 },
+};
+const qint64 UNKNOWN_TOOL_RSS_KB = 100 * 1024;
+
+// Weight of the newest measurement in the running estimate
+const double HISTORY_WEIGHT = 0.3;
+
+// Estimates are read from QSettings once and kept here; changed ones are
+// written back by saveEstimates()
+QMutex estimateMutex;
+QHash<QString, qint64> estimates;
+QSet<QString> changedEstimates;
+
+QString settingsKey(const QString &tool)
+{
+    return "ChildMemory/" + tool + "/peakRssKb";
+}
+
+} // namespace
+
+ProcessGovernor::Ticket::Ticket(ProcessGovernor &governor, const QString &tool, qint64 reservedKb)
+    : m_governor(governor)
+    , m_tool(tool)
+    , m_reservedKb(reservedKb)
+{
+}
+
+ProcessGovernor::Ticket::~Ticket()
+{
+    m_governor.release(m_tool, m_reservedKb);
+}
+
+void ProcessGovernor::Ticket::recordPeakRss(qint64 peakRssKb)
+{
+    if (peakRssKb <= 0) {
+        return;
+    }
+    qint64 previous = expectedRssKb(m_tool);
+    qint64 updated = previous + qint64(HISTORY_WEIGHT * (peakRssKb - previous));
+    
+    QMutexLocker locker(&estimateMutex);
+    estimates.insert(m_tool, updated);
+    changedEstimates.insert(m_tool);
+}
+
+ProcessGovernor &ProcessGovernor::instance()
+{
+    static ProcessGovernor governor;
+    return governor;
+}
+
+ProcessGovernor::ProcessGovernor()
+    : m_maxPerTool(maxChildrenPerTool())
+    , m_budgetKb(memoryBudgetKb())
+{
+    qDebug() << "Process governor:" << m_maxPerTool << "children per tool,"
+             << m_budgetKb / 1024 << "MB for all children";
+}
+
+std::unique_ptr<ProcessGovernor::Ticket> ProcessGovernor::acquire(const QString &tool, quintptr job)
+{
+    QElapsedTimer waited;
+    waited.start();
+    
+    Request request;
+    request.tool = tool;
+    request.rssKb = expectedRssKb(tool);
+    request.waiting.start();
+    
+    QMutexLocker locker(&m_mutex);
+    if (!m_jobOrder.contains(job)) {
+        m_jobOrder.append(job);
+    }
+    m_waiting[job].append(&request);
+    admit();
+    while (!request.admitted) {
+        m_admitted.wait(&m_mutex);
+    }
+    
+    auto ticket = std::make_unique<Ticket>(*this, tool, request.rssKb);
+    ticket->m_waitedMs = waited.elapsed();
+    if (ticket->m_waitedMs >= 100) {
+        qDebug() << "Waited" << ticket->m_waitedMs << "ms to start" << tool
+                 << "(" << m_totalRunning << "children running)";
+    }
+    return ticket;
+}
+
+int ProcessGovernor::maxChildrenPerTool()
+{
+    bool ok;
+    int children = qEnvironmentVariableIntValue("BOOKLET_MAX_CHILDREN", &ok);
+    return ok && children > 0 ? children : qMax(1, QThread::idealThreadCount());
+}
+
+qint64 ProcessGovernor::memoryBudgetKb()
+{
+    bool ok;
+    qint64 megabytes = qEnvironmentVariableIntValue("BOOKLET_CHILD_MEMORY_MB", &ok);
+    if (ok && megabytes > 0) {
+        return megabytes * 1024;
+    }
+    
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || pageSize <= 0) {
+        return 4LL * 1024 * 1024;
+    }
+    // Leave the other half to the app, its caches and everything else
+    return qint64(pages) * pageSize / 1024 / 2;
+}
+
+qint64 ProcessGovernor::expectedRssKb(const QString &tool)
+{
+    QMutexLocker locker(&estimateMutex);
+    auto it = estimates.constFind(tool);
+    if (it != estimates.constEnd()) {
+        return *it;
+    }
+    
+    qint64 rssKb = UNKNOWN_TOOL_RSS_KB;
+    for (const ToolMemory &memory : DEFAULT_MEMORY) {
+        if (tool == QLatin1String(memory.tool)) {
+            rssKb = memory.rssKb;
+        }
+    }
+    QSettings settings;
+    rssKb = settings.value(settingsKey(tool), rssKb).toLongLong();
+    estimates.insert(tool, rssKb);
+    return rssKb;
+}
+
+void ProcessGovernor::saveEstimates()
+{
+    QMutexLocker locker(&estimateMutex);
+    if (changedEstimates.isEmpty()) {
+        return;
+    }
+    QSettings settings;
+    for (const QString &tool : std::as_const(changedEstimates)) {
+        settings.setValue(settingsKey(tool), estimates.value(tool));
+    }
+    changedEstimates.clear();
+}
+
+void ProcessGovernor::admit()
+{
+    // Take the first job in rotation whose oldest request fits, then move
+    // that job to the back; repeat until nothing more fits. A starved
+    // request goes first, and the others only start if they leave it room.
+    bool admitted = true;
+    while (admitted) {
+        admitted = false;
+        Request *starved = starvedRequest();
+        for (int i = 0; i < m_jobOrder.size(); ++i) {
+            const QList<Request *> &queue = m_waiting[m_jobOrder.at(i)];
+            if (queue.isEmpty() || queue.first() != starved || !fits(*starved)) {
+                continue;
+            }
+            grant(i);
+            admitted = true;
+            break;
+        }
+        if (admitted) {
+            continue;
+        }
+        
+        for (int i = 0; i < m_jobOrder.size(); ++i) {
+            const QList<Request *> &queue = m_waiting[m_jobOrder.at(i)];
+            if (queue.isEmpty() || queue.first() == starved || !fits(*queue.first(), starved)) {
+                continue;
+            }
+            grant(i);
+            admitted = true;
+            break;
+        }
+    }
+    m_admitted.wakeAll();
+}
+
+ProcessGovernor::Request *ProcessGovernor::starvedRequest() const
+{
+    // Each job's queue is FIFO, so its first request is its oldest
+    Request *oldest = nullptr;
+    for (const QList<Request *> &queue : m_waiting) {
+        if (!queue.isEmpty()
+            && (!oldest || queue.first()->waiting.elapsed() > oldest->waiting.elapsed())) {
+            oldest = queue.first();
+        }
+    }
+    return oldest && oldest->waiting.elapsed() > STARVATION_MS ? oldest : nullptr;
+}
+
+void ProcessGovernor::grant(int index)
+{
+    quintptr job = m_jobOrder.at(index);
+    QList<Request *> &queue = m_waiting[job];
+    
+    Request *request = queue.takeFirst();
+    request->admitted = true;
+    m_running[request->tool]++;
+    m_totalRunning++;
+    m_reservedKb += request->rssKb;
+    
+    m_jobOrder.removeAt(index);
+    if (queue.isEmpty()) {
+        m_waiting.remove(job);
+    } else {
+        m_jobOrder.append(job);
+    }
+}
+
+bool ProcessGovernor::fits(const Request &request, const Request *reserved) const
+{
+    int running = m_running.value(request.tool);
+    int totalRunning = m_totalRunning;
+    qint64 reservedKb = m_reservedKb;
+    if (reserved) {
+        running += reserved->tool == request.tool ? 1 : 0;
+        totalRunning++;
+        reservedKb += reserved->rssKb;
+    }
+    
+    if (running >= m_maxPerTool) {
+        return false;
+    }
+    // A single child is always let through, however large its estimate
+    return totalRunning == 0 || reservedKb + request.rssKb <= m_budgetKb;
+}
+
+void ProcessGovernor::release(const QString &tool, qint64 reservedKb)
+{
+    QMutexLocker locker(&m_mutex);
+    m_running[tool]--;
+    m_totalRunning--;
+    m_reservedKb -= reservedKb;
+    admit();
+}
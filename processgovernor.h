@@ -0,0 +1,106 @@
+#ifndef PROCESSGOVERNOR_H
+#define PROCESSGOVERNOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <memory>
+
+// Admission control for external tools, shared by every job in the process.
+//
+// Before a pdflatex or qpdf child is started, runTool asks for a ticket.
+// A ticket is granted while fewer children of that tool run than there
+// are cores, and while the expected peak RSS of all running children
+// stays inside a memory budget. Expected RSS is learned per tool from the
+// peaks runTool measures. Waiting requests are served round-robin between
+// jobs, so one large job cannot starve the others, and a request that has
+// waited past STARVATION_MS has room held for it, so a stream of small qpdf
+// children cannot starve a large pdflatex one. Under load, throughput
+// levels off instead of collapsing into swapping.
+class ProcessGovernor
+{
+public:
+    // Held while one child runs; the slot is freed when it goes away
+    class Ticket
+    {
+    public:
+        Ticket(ProcessGovernor &governor, const QString &tool, qint64 reservedKb);
+        ~Ticket();
+        Ticket(const Ticket &) = delete;
+        Ticket &operator=(const Ticket &) = delete;
+        
+        // Feed the child's measured peak RSS back into the estimate. It is
+        // kept in memory until saveEstimates().
+        void recordPeakRss(qint64 peakRssKb);
+        
+        // Time spent waiting for admission
+        qint64 waitedMs() const { return m_waitedMs; }
+    
+    private:
+        friend class ProcessGovernor;
+        ProcessGovernor &m_governor;
+        QString m_tool;
+        qint64 m_reservedKb;
+        qint64 m_waitedMs = 0;
+    };
+    
+    static ProcessGovernor &instance();
+    
+    // Block until a child of tool may start for job, which identifies the
+    // requesting job for fair queueing
+    std::unique_ptr<Ticket> acquire(const QString &tool, quintptr job);
+    
+    // Children of one tool allowed at once; BOOKLET_MAX_CHILDREN or the
+    // core count
+    static int maxChildrenPerTool();
+    // Memory all running children may use together, in kilobytes;
+    // BOOKLET_CHILD_MEMORY_MB or half the physical memory
+    static qint64 memoryBudgetKb();
+    // Expected peak RSS of one child of tool, in kilobytes
+    static qint64 expectedRssKb(const QString &tool);
+    // Write estimates changed since the last call to QSettings; called
+    // once per job rather than once per child
+    static void saveEstimates();
+
+private:
+    ProcessGovernor();
+    
+    struct Request {
+        QString tool;
+        qint64 rssKb;
+        QElapsedTimer waiting;
+        bool admitted = false;
+    };
+    
+    // Wait after which a request has capacity held for it
+    static const qint64 STARVATION_MS = 2000;
+    
+    // Grant waiting requests that now fit, taking jobs in turn
+    void admit();
+    // The request waiting longest, if it has waited past STARVATION_MS
+    Request *starvedRequest() const;
+    // Grant the oldest request of m_jobOrder[index] and rotate that job
+    void grant(int index);
+    // True if request fits next to the running children and, if given, a
+    // starved request that goes first
+    bool fits(const Request &request, const Request *reserved = nullptr) const;
+    void release(const QString &tool, qint64 reservedKb);
+    
+    QMutex m_mutex;
+    QWaitCondition m_admitted;
+    
+    int m_maxPerTool;
+    qint64 m_budgetKb;
+    QHash<QString, int> m_running;
+    int m_totalRunning = 0;
+    qint64 m_reservedKb = 0;
+    
+    // Waiting requests, FIFO per job; jobs are served in rotation
+    QHash<quintptr, QList<Request *>> m_waiting;
+    QList<quintptr> m_jobOrder;
+};
+
+#endif // PROCESSGOVERNOR_H
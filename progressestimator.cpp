@@ -0,0 +1,211 @@
+#include "progressestimator.h"
+#include "stagewatchdog.h"
+#include <QRegularExpression>
+#include <QtGlobal>
+
+namespace {
+
+// Time-based progress never claims a run is done; the tool's exit does
+const double MAX_TIMED_FRACTION = 0.95;
+// Before this share of the work is done, trust the history over this job's
+// own pace
+const double MIN_PACE_SAMPLE = 0.02;
+// Bytes of output kept between scans so markers split across reads match
+const int OUTPUT_TAIL_BYTES = 32;
+
+} // namespace
+
+ProgressEstimator::ProgressEstimator()
+    : m_runPages(0)
+    , m_runExpectedMs(0)
+    , m_runFraction(0)
+    , m_runReportsProgress(false)
+    , m_lastPercent(0)
+{
+}
+
+void ProgressEstimator::start()
+{
+    m_stages.clear();
+    m_runStage.clear();
+    m_runPages = 0;
+    m_runExpectedMs = 0;
+    m_runFraction = 0;
+    m_runReportsProgress = false;
+    m_outputTail.clear();
+    m_lastPercent = 0;
+    m_jobTimer.start();
+}
+
+void ProgressEstimator::finish()
+{
+    finishRun();
+    for (Stage &planned : m_stages) {
+        planned.doneMs = planned.plannedMs;
+    }
+    m_lastPercent = 100;
+}
+
+void ProgressEstimator::planStage(const QString &name, int pages, qint64 inputBytes, int runs)
+{
+    // Every extra run pays the stage's start-up overhead again
+    double expected = StageWatchdog::expectedMs(name, pages, inputBytes)
+                    + (runs - 1) * StageWatchdog::expectedMs(name, 0, 0);
+    Stage &planned = stage(name);
+    planned.plannedMs = qMax(planned.plannedMs, expected);
+}
+
+void ProgressEstimator::dropStage(const QString &name)
+{
+    m_stages.removeIf([&name](const Stage &planned) { return planned.name == name; });
+}
+
+void ProgressEstimator::beginRun(const QString &name, int pages, qint64 inputBytes)
+{
+    finishRun();
+    
+    m_runStage = name;
+    m_runPages = pages;
+    m_runExpectedMs = StageWatchdog::expectedMs(name, pages, inputBytes);
+    m_runFraction = 0;
+    m_runReportsProgress = false;
+    m_outputTail.clear();
+    m_runTimer.start();
+    
+    Stage &planned = stage(name);
+    planned.plannedMs = qMax(planned.plannedMs, planned.doneMs + m_runExpectedMs);
+}
+
+void ProgressEstimator::finishRun()
+{
+    if (m_runStage.isEmpty()) {
+        return;
+    }
+    stage(m_runStage).doneMs += m_runExpectedMs;
+    m_runStage.clear();
+    m_runExpectedMs = 0;
+}
+
+void ProgressEstimator::setRunFraction(double fraction)
+{
+    m_runReportsProgress = true;
+    m_runFraction = qBound(m_runFraction, fraction, 1.0);
+}
+
+void ProgressEstimator::scanOutput(const QByteArray &output)
+{
+    if (output.isEmpty() || m_runStage.isEmpty()) {
+        return;
+    }
+    
+    static const QRegularExpression qpdfProgress("write progress: (\\d+)%");
+    static const QRegularExpression shippedPage("(?:^|[\\s\\]])\\[(\\d+)");
+    
+    QString text = QString::fromLatin1(m_outputTail + output);
+    m_outputTail = output.right(OUTPUT_TAIL_BYTES);
+    
+    // qpdf --progress: "qpdf: out.pdf: write progress: 40%"
+    QRegularExpressionMatchIterator matches = qpdfProgress.globalMatch(text);
+    while (matches.hasNext()) {
+        setRunFraction(matches.next().captured(1).toInt() / 100.0);
+    }
+    
+    // pdflatex prints "[N" as it ships out page N
+    if (m_runPages > 0) {
+        matches = shippedPage.globalMatch(text);
+        while (matches.hasNext()) {
+            int page = matches.next().captured(1).toInt();
+            if (page <= m_runPages) {
+                setRunFraction(double(page) / m_runPages);
+            }
+        }
+    }
+}
+
+int ProgressEstimator::percent()
+{
+    double planned = plannedMs();
+    if (planned <= 0 || m_lastPercent >= 100) {
+        return m_lastPercent;
+    }
+    
+    int current = qBound(0, int(100.0 * completedMs() / planned), 99);
+    m_lastPercent = qMax(m_lastPercent, current);
+    return m_lastPercent;
+}
+
+qint64 ProgressEstimator::remainingMs() const
+{
+    if (m_lastPercent >= 100) {
+        return 0;
+    }
+    double planned = plannedMs();
+    if (planned <= 0) {
+        return -1;
+    }
+    
+    // Scale the work left by this job's pace relative to the history
+    double completed = completedMs();
+    double pace = 1.0;
+    if (completed > MIN_PACE_SAMPLE * planned) {
+        pace = qBound(0.2, m_jobTimer.elapsed() / completed, 5.0);
+    }
+    return qint64((planned - completed) * pace);
+}
+
+QString ProgressEstimator::formatRemaining(qint64 remainingMs)
+{
+    if (remainingMs < 0) {
+        return "estimating time left";
+    }
+    qint64 seconds = (remainingMs + 999) / 1000;
+    if (seconds >= 3600) {
+        return QString("about %1:%2:%3 left").arg(seconds / 3600)
+            .arg(seconds / 60 % 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+    }
+    return QString("about %1:%2 left").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+ProgressEstimator::Stage &ProgressEstimator::stage(const QString &name)
+{
+    for (Stage &planned : m_stages) {
+        if (planned.name == name) {
+            return planned;
+        }
+    }
+    m_stages.append(Stage{name, 0, 0});
+    return m_stages.last();
+}
+
+double ProgressEstimator::runFraction() const
+{
+    if (m_runReportsProgress) {
+        return m_runFraction;
+    }
+    if (m_runExpectedMs <= 0) {
+        return 0;
+    }
+    return qMin(MAX_TIMED_FRACTION, m_runTimer.elapsed() / m_runExpectedMs);
+}
+
+double ProgressEstimator::completedMs() const
+{
+    double completed = 0;
+    for (const Stage &planned : m_stages) {
+        double done = planned.doneMs;
+        if (planned.name == m_runStage) {
+            done += m_runExpectedMs * runFraction();
+        }
+        completed += qMin(done, planned.plannedMs);
+    }
+    return completed;
+}
+
+double ProgressEstimator::plannedMs() const
+{
+    double planned = 0;
+    for (const Stage &entry : m_stages) {
+        planned += entry.plannedMs;
+    }
+    return planned;
+}
@@ -0,0 +1,80 @@
+#ifndef PROGRESSESTIMATOR_H
+#define PROGRESSESTIMATOR_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+// Overall progress and time remaining for one booklet job.
+//
+// Each stage is weighted by its expected duration from the stage history
+// kept by StageWatchdog, so a pdflatex compile of a hundred sheets counts
+// for far more than the page count query before it. Within a run, progress
+// comes from the tool's own output where it reports any (pages shipped by
+// pdflatex, "write progress" from qpdf) and from elapsed against expected
+// time otherwise. The time remaining scales what is left by how fast this
+// job has gone compared to the history.
+class ProgressEstimator
+{
+public:
+    ProgressEstimator();
+    
+    // Forget the previous job
+    void start();
+    // Job finished; progress jumps to 100%
+    void finish();
+    
+    // Announce work the job will do, so it is weighted from the start.
+    // Planning a stage again only ever raises its weight.
+    void planStage(const QString &stage, int pages, qint64 inputBytes, int runs = 1);
+    // Take a stage out of the plan, e.g. when a resumed job reuses its
+    // result, so it neither counts as work left nor skews the pace
+    void dropStage(const QString &stage);
+    
+    // A run of a stage starts or ends. Unplanned runs are added to the plan.
+    void beginRun(const QString &stage, int pages, qint64 inputBytes);
+    void finishRun();
+    
+    // Progress of the current run reported by the tool itself, 0..1
+    void setRunFraction(double fraction);
+    // Look for progress markers in freshly read tool output
+    void scanOutput(const QByteArray &output);
+    
+    // Whole job, 0..100; never goes backwards within a job
+    int percent();
+    // Estimated time left in ms, or -1 while there is nothing to go on
+    qint64 remainingMs() const;
+    QString currentStage() const { return m_runStage; }
+    
+    // "about 1:05 left" for remainingMs(), for progress lines and labels
+    static QString formatRemaining(qint64 remainingMs);
+
+private:
+    struct Stage
+    {
+        QString name;
+        double plannedMs;
+        double doneMs;
+    };
+    
+    Stage &stage(const QString &name);
+    double runFraction() const;
+    double completedMs() const;
+    double plannedMs() const;
+    
+    QList<Stage> m_stages;
+    QElapsedTimer m_jobTimer;
+    
+    QString m_runStage;
+    int m_runPages;
+    double m_runExpectedMs;
+    double m_runFraction;
+    bool m_runReportsProgress;
+    QElapsedTimer m_runTimer;
+    QByteArray m_outputTail;
+    
+    int m_lastPercent;
+};
+
+#endif // PROGRESSESTIMATOR_H
@@ -0,0 +1,89 @@
+#include "rendererloader.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QLibrary>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPluginLoader>
+
+namespace {
+
+QMutex loaderMutex;
+PdfRendererFactory *loadedFactory = nullptr;
+bool loadAttempted = false;
+QString loadError;
+
+} // namespace
+
+std::unique_ptr<PdfRenderer> RendererLoader::createRenderer(QString &error)
+{
+    PdfRendererFactory *backend = factory(error);
+    if (!backend) {
+        return nullptr;
+    }
+    return std::unique_ptr<PdfRenderer>(backend->createRenderer());
+}
+
+bool RendererLoader::isLoaded()
+{
+    QMutexLocker locker(&loaderMutex);
+    return loadedFactory != nullptr;
+}
+
+QStringList RendererLoader::searchPaths()
+{
+    QStringList paths;
+    QString configured = qEnvironmentVariable("BOOKLET_RENDERER_PATH");
+    if (!configured.isEmpty()) {
+        paths += configured.split(QDir::listSeparator(), Qt::SkipEmptyParts);
+    }
+    
+    QString appDir = QCoreApplication::applicationDirPath();
+    paths << appDir + "/renderers";
+#ifdef Q_OS_MACOS
+    paths << appDir + "/../PlugIns/renderers";
+#endif
+    return paths;
+}
+
+PdfRendererFactory *RendererLoader::factory(QString &error)
+{
+    QMutexLocker locker(&loaderMutex);
+    
+    // Scan once; a missing backend stays missing for the session
+    if (!loadAttempted) {
+        loadAttempted = true;
+        
+        for (const QString &path : searchPaths()) {
+            QDir dir(path);
+            for (const QString &fileName : dir.entryList(QDir::Files)) {
+                if (!QLibrary::isLibrary(fileName)) {
+                    continue;
+                }
+                
+                // The loader object may go; the plugin stays loaded
+                QPluginLoader loader(dir.absoluteFilePath(fileName));
+                PdfRendererFactory *backend = qobject_cast<PdfRendererFactory *>(loader.instance());
+                if (!backend) {
+                    qDebug() << "Skipping renderer plugin" << loader.fileName() << loader.errorString();
+                    continue;
+                }
+                
+                qDebug() << "Loaded" << backend->backendName() << "renderer from" << loader.fileName();
+                loadedFactory = backend;
+                break;
+            }
+            if (loadedFactory) {
+                break;
+            }
+        }
+        
+        if (!loadedFactory) {
+            loadError = "No PDF rendering backend found in: " + searchPaths().join(", ");
+        }
+    }
+    
+    error = loadError;
+    return loadedFactory;
+}
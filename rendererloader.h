@@ -0,0 +1,32 @@
+#ifndef RENDERERLOADER_H
+#define RENDERERLOADER_H
+
+#include "pdfrenderer.h"
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+// Finds and loads a rendering backend plugin on first use.
+//
+// Nothing is loaded at startup: the first createRenderer() call scans the
+// plugin directories and keeps the first backend that loads. Runs that
+// never render a page (batch conversion) never load a backend.
+class RendererLoader
+{
+public:
+    // Renderer from the loaded backend, or nullptr with error set when no
+    // backend plugin is available
+    static std::unique_ptr<PdfRenderer> createRenderer(QString &error);
+    
+    // True once a backend has been loaded
+    static bool isLoaded();
+    
+    // Directories searched for backends: BOOKLET_RENDERER_PATH, then
+    // "renderers" next to the executable (or in the bundle's PlugIns)
+    static QStringList searchPaths();
+
+private:
+    static PdfRendererFactory *factory(QString &error);
+};
+
+#endif // RENDERERLOADER_H
@@ -0,0 +1,194 @@
+#include "resourcereport.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <sys/resource.h>
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#elif defined(Q_OS_MACOS)
+#include <libproc.h>
+#include <mach/mach_time.h>
+#endif
+
+ResourceReport::ResourceReport()
+    : m_success(false), m_wallMs(0.0), m_appPeakRssKb(0), m_tempBytesWritten(0)
+{
+}
+
+void ResourceReport::start()
+{
+    m_timer.start();
+}
+
+void ResourceReport::finish(bool success)
+{
+    m_success = success;
+    m_wallMs = m_timer.isValid() ? m_timer.nsecsElapsed() / 1e6 : 0.0;
+    
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        m_appPeakRssKb = maxRssKb(usage);
+    }
+}
+
+void ResourceReport::addToolRun(const QString &tool, double wallMs, double userCpuMs,
+                                double systemCpuMs, qint64 peakRssKb, bool sampled)
+{
+    ToolUsage &usage = m_tools[tool];
+    usage.runs++;
+    usage.wallMs += wallMs;
+    usage.userCpuMs += userCpuMs;
+    usage.systemCpuMs += systemCpuMs;
+    usage.peakRssKb = qMax(usage.peakRssKb, peakRssKb);
+    if (sampled) {
+        usage.sampledRuns++;
+    }
+}
+
+void ResourceReport::mergeToolRuns(const ResourceReport &other)
+{
+    for (auto it = other.m_tools.constBegin(); it != other.m_tools.constEnd(); ++it) {
+        ToolUsage &usage = m_tools[it.key()];
+        usage.runs += it->runs;
+        usage.wallMs += it->wallMs;
+        usage.userCpuMs += it->userCpuMs;
+        usage.systemCpuMs += it->systemCpuMs;
+        usage.peakRssKb = qMax(usage.peakRssKb, it->peakRssKb);
+        usage.sampledRuns += it->sampledRuns;
+    }
+}
+
+double ResourceReport::childCpuMs() const
+{
+    double cpuMs = 0.0;
+    for (const ToolUsage &usage : m_tools) {
+        cpuMs += usage.userCpuMs + usage.systemCpuMs;
+    }
+    return cpuMs;
+}
+
+QJsonObject ResourceReport::toJson() const
+{
+    QJsonObject tools;
+    bool approximate = false;
+    for (auto it = m_tools.constBegin(); it != m_tools.constEnd(); ++it) {
+        const ToolUsage &usage = it.value();
+        tools[it.key()] = QJsonObject{
+            {"runs", usage.runs},
+            {"sampled_runs", usage.sampledRuns},
+            {"wall_ms", usage.wallMs},
+            {"user_cpu_ms", usage.userCpuMs},
+            {"system_cpu_ms", usage.systemCpuMs},
+            {"peak_rss_kb", usage.peakRssKb}
+        };
+        approximate = approximate || usage.sampledRuns > 0;
+    }
+    
+    QJsonObject report;
+    report["success"] = m_success;
+    report["wall_ms"] = m_wallMs;
+    report["child_cpu_ms"] = childCpuMs();
+    // Some tools were sampled while running, so the figures are lower bounds
+    report["child_usage_approximate"] = approximate;
+    report["app_peak_rss_kb"] = m_appPeakRssKb;
+    report["temp_bytes_written"] = m_tempBytesWritten;
+    report["tools"] = tools;
+    return report;
+}
+
+bool ResourceReport::appendToLog(QString &error) const
+{
+    QString path = logPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    
+    QFile log(path);
+    if (!log.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        error = "Cannot open job report log: " + path;
+        return false;
+    }
+    
+    QJsonObject line = toJson();
+    line["finished_at"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    log.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + "\n");
+    return true;
+}
+
+QString ResourceReport::logPath()
+{
+    QString path = qEnvironmentVariable("BOOKLET_REPORT_LOG");
+    if (!path.isEmpty()) {
+        return path;
+    }
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation))
+        .filePath("job-reports.jsonl");
+}
+
+qint64 ResourceReport::maxRssKb(const struct rusage &usage)
+{
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss / 1024;   // bytes on macOS
+#else
+    return usage.ru_maxrss;          // kilobytes on Linux
+#endif
+}
+
+bool ResourceReport::processCpuMs(qint64 pid, double &userCpuMs, double &systemCpuMs)
+{
+#if defined(Q_OS_LINUX)
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // comm may contain spaces, so count fields from its closing parenthesis;
+    // utime, stime, cutime and cstime are fields 14 to 17 of the full line
+    QByteArray line = stat.readAll();
+    int commEnd = line.lastIndexOf(')');
+    QList<QByteArray> fields = commEnd < 0 ? QList<QByteArray>() : line.mid(commEnd + 2).split(' ');
+    if (fields.size() < 15) {
+        return false;
+    }
+    double msPerTick = 1000.0 / sysconf(_SC_CLK_TCK);
+    userCpuMs = (fields.at(11).toLongLong() + fields.at(13).toLongLong()) * msPerTick;
+    systemCpuMs = (fields.at(12).toLongLong() + fields.at(14).toLongLong()) * msPerTick;
+    return true;
+#elif defined(Q_OS_MACOS)
+    struct rusage_info_v2 info;
+    if (proc_pid_rusage(int(pid), RUSAGE_INFO_V2, reinterpret_cast<rusage_info_t *>(&info)) != 0) {
+        return false;
+    }
+    // Mach absolute time units, which are not nanoseconds on Apple silicon
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    double msPerUnit = double(timebase.numer) / timebase.denom / 1e6;
+    userCpuMs = (info.ri_user_time + info.ri_child_user_time) * msPerUnit;
+    systemCpuMs = (info.ri_system_time + info.ri_child_system_time) * msPerUnit;
+    return true;
+#else
+    Q_UNUSED(pid);
+    Q_UNUSED(userCpuMs);
+    Q_UNUSED(systemCpuMs);
+    return false;
+#endif
+}
+
+qint64 ResourceReport::processPeakRssKb(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile status(QString("/proc/%1/status").arg(pid));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    // VmHWM:    123456 kB
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+#else
+    Q_UNUSED(pid);
+#endif
+    return 0;
+}
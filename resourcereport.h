@@ -0,0 +1,74 @@
+#ifndef RESOURCEREPORT_H
+#define RESOURCEREPORT_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+
+struct rusage;
+
+// Resource use of one booklet job: CPU time and peak RSS of every external
+// tool it ran, peak RSS of the app, temp bytes written and wall time.
+// Sent with processingComplete and appended to a JSON-lines log file.
+class ResourceReport
+{
+public:
+    ResourceReport();
+    
+    void start();
+    void finish(bool success);
+    
+    // Account one finished run of an external tool. sampled marks CPU and
+    // peak RSS that were sampled while the tool ran rather than taken from
+    // its exit status, and so may fall short.
+    void addToolRun(const QString &tool, double wallMs, double userCpuMs,
+                    double systemCpuMs, qint64 peakRssKb, bool sampled = false);
+    
+    // Add the tool runs of another report, e.g. one kept by a parallel task
+    void mergeToolRuns(const ResourceReport &other);
+    
+    // Account bytes left in a scratch directory when it is removed
+    void addTempBytes(qint64 bytes) { m_tempBytesWritten += bytes; }
+    
+    // CPU time of every tool run accounted so far
+    double childCpuMs() const;
+    
+    QJsonObject toJson() const;
+    
+    // Append the report as one JSON line to logPath()
+    bool appendToLog(QString &error) const;
+    
+    // BOOKLET_REPORT_LOG, or job-reports.jsonl in the app data directory
+    static QString logPath();
+    
+    // ru_maxrss in kilobytes on every platform
+    static qint64 maxRssKb(const struct rusage &usage);
+    
+    // Peak RSS so far of a running child, in kilobytes (0 if unknown)
+    static qint64 processPeakRssKb(qint64 pid);
+    
+    // User and system CPU used so far by a running child and the children
+    // it has reaped. Leaves the values alone and returns false if the
+    // process cannot be read.
+    static bool processCpuMs(qint64 pid, double &userCpuMs, double &systemCpuMs);
+    
+private:
+    struct ToolUsage {
+        int runs = 0;
+        double wallMs = 0.0;
+        double userCpuMs = 0.0;
+        double systemCpuMs = 0.0;
+        qint64 peakRssKb = 0;
+        int sampledRuns = 0;
+    };
+    
+    QMap<QString, ToolUsage> m_tools;
+    QElapsedTimer m_timer;
+    bool m_success;
+    double m_wallMs;
+    qint64 m_appPeakRssKb;
+    qint64 m_tempBytesWritten;
+};
+
+#endif // RESOURCEREPORT_H
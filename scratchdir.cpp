@@ -0,0 +1,129 @@
+#include "scratchdir.h"
+#include "resourcereport.h"
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QStorageInfo>
+
+ScratchDir::ScratchDir(qint64 estimatedBytes, ResourceReport *report)
+    : m_inMemory(false), m_report(report)
+{
+    createTemporary(estimatedBytes);
+}
+
+ScratchDir::ScratchDir(const QString &durablePath, qint64 estimatedBytes, ResourceReport *report)
+    : m_inMemory(false), m_report(report)
+{
+    if (durablePath.isEmpty()) {
+        createTemporary(estimatedBytes);
+        return;
+    }
+    
+    // Never memory-backed: the point is to survive a reboot
+    m_durablePath = QDir(durablePath).absolutePath();
+    QDir().mkpath(m_durablePath);
+    qDebug() << "Scratch directory:" << m_durablePath << "(durable)";
+}
+
+void ScratchDir::createTemporary(qint64 estimatedBytes)
+{
+    // An explicit scratch location always wins
+    QString root = qEnvironmentVariable("BOOKLET_SCRATCH_DIR");
+    
+    if (root.isEmpty() && estimatedBytes <= memoryThreshold()) {
+        root = memoryBackedRoot(estimatedBytes);
+        m_inMemory = !root.isEmpty();
+    }
+    
+    if (root.isEmpty()) {
+        m_dir.reset(new QTemporaryDir());
+    } else {
+        m_dir.reset(new QTemporaryDir(QDir(root).filePath("a6booklet-XXXXXX")));
+        if (!m_dir->isValid()) {
+            // Fall back to the regular temp directory
+            qDebug() << "Scratch root not usable, falling back to temp path:" << root;
+            m_dir.reset(new QTemporaryDir());
+            m_inMemory = false;
+        }
+    }
+    
+    qDebug() << "Scratch directory:" << path()
+             << (m_inMemory ? "(memory-backed)" : "(disk)")
+             << "estimated bytes:" << estimatedBytes;
+}
+
+ScratchDir::~ScratchDir()
+{
+    if (m_report && isValid()) {
+        m_report->addTempBytes(bytesUsed());
+    }
+}
+
+bool ScratchDir::isValid() const
+{
+    if (isDurable()) {
+        return QFileInfo(m_durablePath).isDir();
+    }
+    return m_dir->isValid();
+}
+
+QString ScratchDir::path() const
+{
+    return isDurable() ? m_durablePath : m_dir->path();
+}
+
+QString ScratchDir::filePath(const QString &fileName) const
+{
+    return isDurable() ? QDir(m_durablePath).filePath(fileName) : m_dir->filePath(fileName);
+}
+
+qint64 ScratchDir::bytesUsed() const
+{
+    qint64 total = 0;
+    QDirIterator it(path(), QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
+
+qint64 ScratchDir::memoryThreshold()
+{
+    bool ok;
+    qint64 megabytes = qEnvironmentVariableIntValue("BOOKLET_SCRATCH_RAM_LIMIT", &ok);
+    if (!ok) {
+        megabytes = 256;
+    }
+    return megabytes * 1024 * 1024;
+}
+
+QString ScratchDir::memoryBackedRoot(qint64 estimatedBytes)
+{
+    QStringList candidates = {
+        qEnvironmentVariable("XDG_RUNTIME_DIR"),
+        "/dev/shm"
+    };
+    
+    for (const QString &candidate : candidates) {
+        if (candidate.isEmpty() || !QFileInfo(candidate).isWritable()) {
+            continue;
+        }
+        
+        QStorageInfo storage(candidate);
+        QByteArray type = storage.fileSystemType();
+        if (type != "tmpfs" && type != "ramfs") {
+            continue;
+        }
+        
+        // Keep headroom so a scratch job never fills shared memory
+        if (storage.bytesAvailable() < estimatedBytes * 2) {
+            continue;
+        }
+        
+        return candidate;
+    }
+    
+    return QString();
+}
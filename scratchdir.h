@@ -0,0 +1,57 @@
+#ifndef SCRATCHDIR_H
+#define SCRATCHDIR_H
+
+#include <QString>
+#include <QTemporaryDir>
+#include <memory>
+
+class ResourceReport;
+
+// Temporary working directory for intermediate PDFs handed between stages.
+// Small jobs are placed on a memory-backed filesystem (tmpfs) when one is
+// available so stage handoffs never touch the disk; jobs whose intermediates
+// would exceed the memory threshold spill to the regular temp directory.
+class ScratchDir
+{
+public:
+    // estimatedBytes is the expected total size of all intermediates. If a
+    // report is given, the bytes left in the directory are added to its temp
+    // byte count when the directory is removed.
+    explicit ScratchDir(qint64 estimatedBytes = 0, ResourceReport *report = nullptr);
+    // Durable directory at durablePath, which is created if needed and kept
+    // when this object goes away, so a resumed job finds its intermediates.
+    // An empty durablePath behaves like the temporary constructor.
+    ScratchDir(const QString &durablePath, qint64 estimatedBytes, ResourceReport *report);
+    ~ScratchDir();
+    
+    bool isValid() const;
+    QString path() const;
+    QString filePath(const QString &fileName) const;
+    
+    // Total size of the files currently in the directory
+    qint64 bytesUsed() const;
+    
+    // True if the directory lives on a memory-backed filesystem
+    bool isInMemory() const { return m_inMemory; }
+    
+    // True if the directory outlives this object
+    bool isDurable() const { return !m_durablePath.isEmpty(); }
+    
+    // Largest estimate that may be kept in memory, in bytes.
+    // Overridable with BOOKLET_SCRATCH_RAM_LIMIT (in megabytes).
+    static qint64 memoryThreshold();
+    
+private:
+    // Memory-backed directory able to hold estimatedBytes, or empty
+    static QString memoryBackedRoot(qint64 estimatedBytes);
+    
+    // Pick the root and create the temporary directory
+    void createTemporary(qint64 estimatedBytes);
+    
+    std::unique_ptr<QTemporaryDir> m_dir;
+    QString m_durablePath;
+    bool m_inMemory;
+    ResourceReport *m_report;
+};
+
+#endif // SCRATCHDIR_H
@@ -0,0 +1,453 @@
+#include "spawnhelper.h"
+#include <QDebug>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+// posix_spawn can change directory only through this extension
+#if defined(__APPLE__) || (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+#define SPAWN_HAS_CHDIR 1
+#endif
+
+namespace {
+
+// Requests are datagrams; longer ones (a reorder of a huge document, say)
+// fail to send and are started by the caller instead
+const int MAX_REQUEST_BYTES = 1024 * 1024;
+
+// How often the helper checks that the app is still alive
+const int PARENT_CHECK_MS = 1000;
+
+// Written by the SIGCHLD handler, read by the helper's main loop
+int childPipe[2] = { -1, -1 };
+
+void childExited(int)
+{
+    int savedErrno = errno;
+    char byte = 0;
+    (void)!write(childPipe[1], &byte, 1);
+    errno = savedErrno;
+}
+
+void setCloseOnExec(int fd)
+{
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+// A datagram socket pair that closes on exec. Where the flag can be given
+// at creation, no other thread's fork can inherit the pair in between.
+bool makeSocketPair(int fds[2])
+{
+#ifdef SOCK_CLOEXEC
+    return socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) == 0;
+#else
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0) {
+        return false;
+    }
+    setCloseOnExec(fds[0]);
+    setCloseOnExec(fds[1]);
+    return true;
+#endif
+}
+
+void sendReply(int replyFd, const SpawnHelper::Reply &reply)
+{
+    while (send(replyFd, &reply, sizeof(reply), 0) < 0 && errno == EINTR) {
+    }
+}
+
+// A started child the helper has not reaped yet
+struct Child {
+    int replyFd;
+    bool listening;             // the app may still send signals
+};
+
+// Send the exit of every reaped child to whoever asked for it
+void reapChildren(std::map<pid_t, Child> &waiting)
+{
+    SpawnHelper::Reply reply;
+    std::memset(&reply, 0, sizeof(reply));
+    reply.kind = SpawnHelper::Exited;
+    
+    pid_t pid;
+    while ((pid = wait4(-1, &reply.status, WNOHANG, &reply.usage)) > 0) {
+        auto it = waiting.find(pid);
+        if (it == waiting.end()) {
+            continue;
+        }
+        reply.pid = pid;
+        sendReply(it->second.replyFd, reply);
+        close(it->second.replyFd);
+        waiting.erase(it);
+    }
+}
+
+// Deliver a signal the app sent for one of its children. The child is
+// still in waiting, so it has not been reaped and its pid cannot have
+// been reused.
+void forwardSignal(pid_t pid, Child &child)
+{
+    int signal = 0;
+    ssize_t length;
+    do {
+        length = recv(child.replyFd, &signal, sizeof(signal), MSG_DONTWAIT);
+    } while (length < 0 && errno == EINTR);
+    
+    if (length == ssize_t(sizeof(signal))) {
+        kill(pid, signal);
+    } else if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        // The app closed its end; the exit reply will go nowhere
+        child.listening = false;
+    }
+}
+
+// Payload: program, working directory, argument count, arguments,
+// environment count (-1 to inherit), environment; each NUL-terminated
+void handleRequest(int controlFd, std::vector<char> &buffer, std::map<pid_t, Child> &waiting)
+{
+    struct iovec iov;
+    iov.iov_base = buffer.data();
+    iov.iov_len = buffer.size() - 1;
+    union {
+        char data[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+    
+    int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+    ssize_t length = recvmsg(controlFd, &message, flags);
+    if (length < 0) {
+        return;
+    }
+    
+    int fds[3] = { -1, -1, -1 };
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS
+        && header->cmsg_len == CMSG_LEN(3 * sizeof(int))) {
+        std::memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    }
+    for (int fd : fds) {
+        if (fd >= 0) {
+            setCloseOnExec(fd);
+        }
+    }
+    int replyFd = fds[0];
+    int stdoutFd = fds[1];
+    int stderrFd = fds[2];
+    if (replyFd < 0 || stdoutFd < 0 || stderrFd < 0) {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        return;
+    }
+    
+    SpawnHelper::Reply reply;
+    std::memset(&reply, 0, sizeof(reply));
+    reply.kind = SpawnHelper::Started;
+    
+    // Split the payload into its NUL-terminated fields
+    buffer[length] = '\0';
+    std::vector<char *> fields;
+    for (ssize_t i = 0; i < length; i += std::strlen(buffer.data() + i) + 1) {
+        fields.push_back(buffer.data() + i);
+    }
+    
+    std::vector<char *> argv;
+    std::vector<char *> envp;
+    bool inheritEnvironment = true;
+    bool valid = (message.msg_flags & MSG_TRUNC) == 0 && fields.size() >= 4;
+    if (valid) {
+        size_t next = 2;
+        long argc = std::strtol(fields[next++], nullptr, 10);
+        for (long i = 0; i < argc && next < fields.size(); ++i) {
+            argv.push_back(fields[next++]);
+        }
+        long envc = next < fields.size() ? std::strtol(fields[next++], nullptr, 10) : -1;
+        inheritEnvironment = envc < 0;
+        for (long i = 0; i < envc && next < fields.size(); ++i) {
+            envp.push_back(fields[next++]);
+        }
+    }
+    if (!valid || argv.empty()) {
+        reply.error = EINVAL;
+    }
+    argv.push_back(nullptr);
+    envp.push_back(nullptr);
+    
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, stdoutFd, 1);
+    posix_spawn_file_actions_adddup2(&actions, stderrFd, 2);
+    if (reply.error == 0 && fields[1][0] != '\0') {
+#ifdef SPAWN_HAS_CHDIR
+        posix_spawn_file_actions_addchdir_np(&actions, fields[1]);
+#else
+        reply.error = ENOSYS;
+#endif
+    }
+    
+    // The helper ignores SIGPIPE and handles SIGCHLD; the child must not
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    sigaddset(&signals, SIGPIPE);
+    sigaddset(&signals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attributes, &signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    
+    if (reply.error == 0) {
+        pid_t pid = 0;
+        // Search PATH for bare names, as QProcess does
+        reply.error = posix_spawnp(&pid, fields[0], &actions, &attributes, argv.data(),
+                                   inheritEnvironment ? environ : envp.data());
+        reply.pid = pid;
+    }
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(stdoutFd);
+    close(stderrFd);
+    
+    sendReply(replyFd, reply);
+    if (reply.error == 0) {
+        waiting[reply.pid] = Child{ replyFd, true };
+    } else {
+        close(replyFd);
+    }
+}
+
+} // namespace
+
+int SpawnHelper::s_controlFd = -1;
+
+void SpawnHelper::start()
+{
+    if (qEnvironmentVariable("BOOKLET_SPAWN_HELPER") == "0") {
+        return;
+    }
+    
+    int fds[2];
+    if (!makeSocketPair(fds)) {
+        qDebug() << "Spawn helper: no socket pair:" << std::strerror(errno);
+        return;
+    }
+    // Default datagram limits are far too small for a long qpdf command
+    // line on macOS
+    int bytes = MAX_REQUEST_BYTES;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        qDebug() << "Spawn helper: fork failed:" << std::strerror(errno);
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        serve(fds[1], parent);
+    }
+    
+    close(fds[1]);
+    s_controlFd = fds[0];
+}
+
+bool SpawnHelper::isRunning()
+{
+    return s_controlFd >= 0;
+}
+
+bool SpawnHelper::request(const QByteArray &program, const QList<QByteArray> &args,
+                          const QByteArray &workingDirectory, const QList<QByteArray> *environment,
+                          int stdoutFd, int stderrFd, int &replyFd)
+{
+    if (s_controlFd < 0) {
+        return false;
+    }
+    
+    QByteArray payload;
+    payload.append(program).append('\0');
+    payload.append(workingDirectory).append('\0');
+    // argv[0] is the program itself
+    payload.append(QByteArray::number(args.size() + 1)).append('\0');
+    payload.append(program).append('\0');
+    for (const QByteArray &arg : args) {
+        payload.append(arg).append('\0');
+    }
+    payload.append(QByteArray::number(environment ? environment->size() : -1)).append('\0');
+    if (environment) {
+        for (const QByteArray &entry : *environment) {
+            payload.append(entry).append('\0');
+        }
+    }
+    if (payload.size() >= MAX_REQUEST_BYTES) {
+        return false;
+    }
+    
+    int pair[2];
+    if (!makeSocketPair(pair)) {
+        return false;
+    }
+    
+    struct iovec iov;
+    iov.iov_base = payload.data();
+    iov.iov_len = payload.size();
+    union {
+        char data[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    std::memset(&control, 0, sizeof(control));
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+    
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    int fds[3] = { pair[1], stdoutFd, stderrFd };
+    std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+    
+    // One datagram per request, so threads need no lock to share the socket
+    ssize_t sent;
+    do {
+        sent = sendmsg(s_controlFd, &message, 0);
+    } while (sent < 0 && errno == EINTR);
+    close(pair[1]);
+    
+    if (sent < 0) {
+        qDebug() << "Spawn helper did not take the request:" << std::strerror(errno);
+        close(pair[0]);
+        return false;
+    }
+    replyFd = pair[0];
+    return true;
+}
+
+bool SpawnHelper::readReply(int replyFd, int timeoutMs, Reply &reply)
+{
+    struct pollfd pending = { replyFd, POLLIN, 0 };
+    int ready;
+    do {
+        ready = poll(&pending, 1, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    if (ready <= 0) {
+        return false;
+    }
+    
+    ssize_t length;
+    do {
+        length = recv(replyFd, &reply, sizeof(reply), 0);
+    } while (length < 0 && errno == EINTR);
+    return length == ssize_t(sizeof(reply));
+}
+
+bool SpawnHelper::signalChild(int replyFd, int signal)
+{
+    ssize_t sent;
+    do {
+        sent = send(replyFd, &signal, sizeof(signal), 0);
+    } while (sent < 0 && errno == EINTR);
+    return sent == ssize_t(sizeof(signal));
+}
+
+void SpawnHelper::serve(int controlFd, pid_t parent)
+{
+#ifdef Q_OS_LINUX
+    if (pipe2(childPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        _exit(1);
+    }
+#else
+    if (pipe(childPipe) != 0) {
+        _exit(1);
+    }
+    for (int fd : childPipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        setCloseOnExec(fd);
+    }
+#endif
+    
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = childExited;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    
+    std::vector<char> buffer(MAX_REQUEST_BYTES + 1);
+    std::map<pid_t, Child> waiting;
+    std::vector<struct pollfd> fds;
+    std::vector<pid_t> pids;
+    
+    while (true) {
+        // The control socket, the SIGCHLD pipe, then every running child's
+        // reply socket for signals from the app
+        fds.assign({ { controlFd, POLLIN, 0 }, { childPipe[0], POLLIN, 0 } });
+        pids.clear();
+        for (const auto &entry : waiting) {
+            if (entry.second.listening) {
+                fds.push_back({ entry.second.replyFd, POLLIN, 0 });
+                pids.push_back(entry.first);
+            }
+        }
+        
+        int ready = poll(fds.data(), fds.size(), PARENT_CHECK_MS);
+        if (ready < 0 && errno != EINTR) {
+            _exit(1);
+        }
+        // Nobody left to serve once the app is gone
+        if (getppid() != parent) {
+            _exit(0);
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        
+        // Signals first: a child reaped below can no longer be signalled
+        for (size_t i = 0; i < pids.size(); ++i) {
+            short events = fds[i + 2].revents;
+            if (events & POLLIN) {
+                forwardSignal(pids[i], waiting[pids[i]]);
+            } else if (events & (POLLERR | POLLHUP | POLLNVAL)) {
+                waiting[pids[i]].listening = false;
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(childPipe[0], drain, sizeof(drain)) > 0) {
+            }
+            reapChildren(waiting);
+        }
+        if (fds[0].revents & POLLIN) {
+            handleRequest(controlFd, buffer, waiting);
+        }
+    }
+}
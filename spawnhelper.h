@@ -0,0 +1,74 @@
+#ifndef SPAWNHELPER_H
+#define SPAWNHELPER_H
+
+#include <QByteArray>
+#include <QList>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+// Small process that launches tool children for the app.
+//
+// A fork copies the page tables of the whole caller. Once the app holds a
+// large heap and the preview cache, each QProcess::start gets slower,
+// and a job runs qpdf many times. The helper is forked from main() before
+// QApplication exists, so its address space stays a few megabytes. It
+// takes launch requests over a socket pair and starts each child with
+// posix_spawn.
+//
+// The caller makes the child's stdout and stderr pipes itself and passes
+// them over with SCM_RIGHTS, together with one end of a fresh reply socket.
+// The helper answers on that socket with the pid. When the child has been
+// reaped it sends the exit status and the child's own rusage from wait4.
+// Signals for a running child go back over the same socket: only the
+// helper knows whether the child has been reaped yet, so only it can
+// signal the pid without hitting a reused one.
+// Used through ToolProcess, which falls back to QProcess when the helper
+// is not running or cannot take a request.
+class SpawnHelper
+{
+public:
+    struct Reply {
+        int kind;               // Started or Exited
+        int pid;
+        int error;              // errno of a failed spawn
+        int status;             // wait status of an exited child
+        struct rusage usage;
+    };
+    enum ReplyKind {
+        Started,
+        Exited
+    };
+    
+    // Fork the helper. Call at the top of main(), before any thread or
+    // QApplication exists. BOOKLET_SPAWN_HELPER=0 turns it off.
+    static void start();
+    static bool isRunning();
+    
+    // Ask the helper to launch program. stdoutFd and stderrFd become the
+    // child's 1 and 2, and the helper keeps its own copies only until the
+    // child has started. workingDirectory may be empty. environment is
+    // "NAME=value" entries, or null to inherit the environment the app
+    // was launched with. On success replyFd is the socket the Started and
+    // Exited replies arrive on; the caller closes it. Returns false if the
+    // request could not be delivered, in which case the caller should start
+    // the child itself.
+    static bool request(const QByteArray &program, const QList<QByteArray> &args,
+                        const QByteArray &workingDirectory, const QList<QByteArray> *environment,
+                        int stdoutFd, int stderrFd, int &replyFd);
+    
+    // Read one reply, waiting at most timeoutMs (-1 waits forever).
+    // Returns false on timeout or if the helper went away.
+    static bool readReply(int replyFd, int timeoutMs, Reply &reply);
+    
+    // Have the helper send signal to the child replyFd belongs to, unless
+    // it has already been reaped
+    static bool signalChild(int replyFd, int signal);
+
+private:
+    // Helper main loop; never returns
+    [[noreturn]] static void serve(int controlFd, pid_t parent);
+    
+    static int s_controlFd;
+};
+
+#endif // SPAWNHELPER_H
@@ -0,0 +1,206 @@
+#include "stagetracer.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QThread>
+#include <sys/resource.h>
+#ifdef Q_OS_MACOS
+#include <mach/mach.h>
+#endif
+
+namespace {
+
+// User plus system CPU seconds of the calling thread, so scheduler
+// workers and other jobs running at the same time are not counted
+double threadCpuSeconds()
+{
+#if defined(Q_OS_MACOS)
+    mach_port_t thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    kern_return_t result = thread_info(thread, THREAD_BASIC_INFO,
+                                       reinterpret_cast<thread_info_t>(&info), &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (result != KERN_SUCCESS) {
+        return 0.0;
+    }
+    return info.user_time.seconds + info.user_time.microseconds / 1e6
+         + info.system_time.seconds + info.system_time.microseconds / 1e6;
+#else
+#ifdef RUSAGE_THREAD
+    const int who = RUSAGE_THREAD;
+#else
+    const int who = RUSAGE_SELF;
+#endif
+    struct rusage usage;
+    if (getrusage(who, &usage) != 0) {
+        return 0.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+} // namespace
+
+StageTracer &StageTracer::instance()
+{
+    static StageTracer tracer;
+    return tracer;
+}
+
+StageTracer::StageTracer()
+    : m_outputPath(qEnvironmentVariable("BOOKLET_TRACE"))
+{
+    m_clock.start();
+}
+
+void StageTracer::setOutputPath(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    m_outputPath = path;
+    m_fileStarted = false;
+    m_written = 0;
+}
+
+void StageTracer::setKeepEvents(bool keep)
+{
+    QMutexLocker locker(&m_mutex);
+    m_keepEvents = keep;
+}
+
+void StageTracer::record(const QJsonObject &event)
+{
+    QMutexLocker locker(&m_mutex);
+    m_events.append(event);
+}
+
+QJsonArray StageTracer::events()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_events;
+}
+
+void StageTracer::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_events = QJsonArray();
+    m_written = 0;
+}
+
+bool StageTracer::flush(QString &error)
+{
+    if (!isEnabled()) {
+        return true;
+    }
+    
+    // Held while writing so concurrent jobs append whole batches in order
+    QMutexLocker locker(&m_mutex);
+    if (m_written == m_events.size()) {
+        return true;
+    }
+    
+    // The first flush of a run starts a fresh file; later ones append
+    QFile file(m_outputPath);
+    QIODevice::OpenMode mode = m_fileStarted ? QIODevice::Append : QIODevice::Truncate;
+    if (!file.open(QIODevice::WriteOnly | mode)) {
+        error = "Cannot write trace file: " + m_outputPath;
+        return false;
+    }
+    
+    QByteArray batch;
+    if (!m_fileStarted) {
+        batch += "[\n";
+    }
+    for (int i = m_written; i < m_events.size(); ++i) {
+        batch += QJsonDocument(m_events.at(i).toObject()).toJson(QJsonDocument::Compact);
+        batch += ",\n";
+    }
+    if (file.write(batch) != batch.size() || !file.flush()) {
+        error = "Cannot write trace file: " + m_outputPath;
+        return false;
+    }
+    m_fileStarted = true;
+    
+    if (m_keepEvents) {
+        m_written = m_events.size();
+    } else {
+        m_events = QJsonArray();
+        m_written = 0;
+    }
+    
+    qDebug() << "Trace written to" << m_outputPath;
+    return true;
+}
+
+TraceSpan::TraceSpan(const QString &name, const ResourceReport *job, const QString &category)
+    : m_enabled(StageTracer::instance().isEnabled()),
+      m_finished(false),
+      m_name(name),
+      m_category(category),
+      m_job(job),
+      m_start(0),
+      m_childCpuStart(0.0),
+      m_selfCpuStart(0.0),
+      m_bytesRead(0),
+      m_bytesWritten(0)
+{
+    if (!m_enabled) {
+        return;
+    }
+    
+    m_start = StageTracer::instance().now();
+    m_childCpuStart = m_job ? m_job->childCpuMs() : 0.0;
+    m_selfCpuStart = threadCpuSeconds();
+}
+
+TraceSpan::~TraceSpan()
+{
+    finish();
+}
+
+void TraceSpan::finish()
+{
+    if (!m_enabled || m_finished) {
+        return;
+    }
+    m_finished = true;
+    
+    StageTracer &tracer = StageTracer::instance();
+    qint64 end = tracer.now();
+    
+    // Only the tools the job itself ran, whichever thread they ran on
+    if (m_job) {
+        m_args["child_cpu_ms"] = m_job->childCpuMs() - m_childCpuStart;
+    }
+    m_args["self_cpu_ms"] = (threadCpuSeconds() - m_selfCpuStart) * 1000.0;
+    m_args["bytes_read"] = m_bytesRead;
+    m_args["bytes_written"] = m_bytesWritten;
+    
+    QJsonObject event;
+    event["name"] = m_name;
+    event["cat"] = m_category;
+    event["ph"] = "X";
+    event["ts"] = m_start;
+    event["dur"] = end - m_start;
+    event["pid"] = QCoreApplication::applicationPid();
+    event["tid"] = static_cast<qint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    event["args"] = m_args;
+    tracer.record(event);
+}
+
+void TraceSpan::addFileRead(const QString &path)
+{
+    if (m_enabled) {
+        m_bytesRead += QFileInfo(path).size();
+    }
+}
+
+void TraceSpan::addFileWritten(const QString &path)
+{
+    if (m_enabled) {
+        m_bytesWritten += QFileInfo(path).size();
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef STAGETRACER_H
+#define STAGETRACER_H
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+class ResourceReport;
+
+// Collects timed spans for the stages of a booklet job and exports them in
+// Chrome trace format (load the file in chrome://tracing or Perfetto).
+// Tracing is enabled by BOOKLET_TRACE=<file> or the --trace command line flag.
+class StageTracer
+{
+public:
+    static StageTracer &instance();
+    
+    bool isEnabled() const { return !m_outputPath.isEmpty(); }
+    void setOutputPath(const QString &path);
+    QString outputPath() const { return m_outputPath; }
+    
+    // Microseconds since the tracer was created
+    qint64 now() const { return m_clock.nsecsElapsed() / 1000; }
+    
+    // Add one complete ("X") event
+    void record(const QJsonObject &event);
+    
+    // Append the events recorded since the last flush to the output file
+    // and drop them, so long-running daemons keep only the open jobs'
+    // events in memory. The file uses the JSON array trace format, which
+    // viewers accept without the closing bracket.
+    bool flush(QString &error);
+    
+    // Keep events in memory after they are written, for events() (used by
+    // the benchmark, which clears them per iteration)
+    void setKeepEvents(bool keep);
+    
+    // Events recorded so far, and discard them
+    QJsonArray events();
+    void clear();
+    
+private:
+    StageTracer();
+    
+    QString m_outputPath;
+    QElapsedTimer m_clock;
+    QMutex m_mutex;
+    QJsonArray m_events;
+    int m_written = 0;          // leading events of m_events already in the file
+    bool m_fileStarted = false;
+    bool m_keepEvents = false;
+};
+
+// Scoped span: records wall time, CPU time of its own thread and of the
+// tools job accounted while it was open, and the bytes the stage read and
+// wrote. Nested spans show up nested in the trace viewer.
+class TraceSpan
+{
+public:
+    // job is the report of the job whose stage this is; it must outlive
+    // the span. Without one the span records no child CPU.
+    explicit TraceSpan(const QString &name, const ResourceReport *job = nullptr,
+                       const QString &category = "stage");
+    ~TraceSpan();
+    
+    void addBytesRead(qint64 bytes) { m_bytesRead += bytes; }
+    void addBytesWritten(qint64 bytes) { m_bytesWritten += bytes; }
+    
+    // Convenience: add the size of a file that was read or written
+    void addFileRead(const QString &path);
+    void addFileWritten(const QString &path);
+    
+    void setArg(const QString &key, const QJsonValue &value) { m_args[key] = value; }
+    
+    // Close the span before it goes out of scope
+    void finish();
+    
+private:
+    bool m_enabled;
+    bool m_finished;
+    QString m_name;
+    QString m_category;
+    const ResourceReport *m_job;
+    qint64 m_start;
+    double m_childCpuStart;     // milliseconds
+    double m_selfCpuStart;
+    qint64 m_bytesRead;
+    qint64 m_bytesWritten;
+    QJsonObject m_args;
+};
+
+#endif // STAGETRACER_H
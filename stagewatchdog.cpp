@@ -0,0 +1,273 @@
+#include "stagewatchdog.h"
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QSettings>
+#include <QtGlobal>
+#include <climits>
+
+namespace {
+
+// Starting rates for a stage with no history yet
+struct StageCost
+{
+    const char *stage;
+    double overheadMs;      // process start-up, fixed per run
+    double msPerPage;
+    double msPerMegabyte;
+};
+
+const StageCost defaultCosts[] = {
+    { "pagecount",  200,   0,  50 },
+    { "padding",    200,   2,   0 },
+    { "concat",     300,  10, 100 },
+    { "reorder",    300,  10, 100 },
+    { "compile",   1500, 300, 200 },
+    { "combine",    300,  10, 100 },
+    { "probe",      500,   0,   0 },
+    // In-process passes, timed for progress estimates only
+    { "downsample",  50,  20, 500 },
+    { "optimize",    50,   5, 300 },
+};
+
+const StageCost unknownStageCost = { "", 1000, 50, 200 };
+
+// Deadline = slack + margin * expected duration
+const int DEADLINE_SLACK_MS = 5000;
+const double DEADLINE_MARGIN = 4.0;
+// Weight of the newest run in the learned rates
+const double HISTORY_WEIGHT = 0.3;
+
+// Learned rates, read from QSettings once per stage and kept here;
+// changed ones are written back by saveHistory()
+struct StageRates
+{
+    double msPerPage;
+    double msPerMegabyte;
+};
+
+QMutex historyMutex;
+QHash<QString, StageRates> history;
+QSet<QString> changedStages;
+
+const StageCost &defaultCost(const QString &stage)
+{
+    for (const StageCost &cost : defaultCosts) {
+        if (stage == QLatin1String(cost.stage)) {
+            return cost;
+        }
+    }
+    return unknownStageCost;
+}
+
+QString settingsGroup(const QString &stage)
+{
+    return QString("StageTimings/%1").arg(stage);
+}
+
+// The rates for stage; historyMutex must be held
+StageRates &stageRates(const QString &stage)
+{
+    auto it = history.find(stage);
+    if (it == history.end()) {
+        const StageCost &cost = defaultCost(stage);
+        QSettings settings;
+        settings.beginGroup(settingsGroup(stage));
+        StageRates rates;
+        rates.msPerPage = settings.value("msPerPage", cost.msPerPage).toDouble();
+        rates.msPerMegabyte = settings.value("msPerMegabyte", cost.msPerMegabyte).toDouble();
+        it = history.insert(stage, rates);
+    }
+    return *it;
+}
+
+// True if the process is in an uninterruptible wait, which on Linux means
+// blocked on disk or network I/O
+bool waitingOnIo(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // pid (comm) state ...
+    QByteArray line = stat.readAll();
+    int commEnd = line.lastIndexOf(')');
+    return commEnd >= 0 && line.mid(commEnd + 2, 1) == "D";
+#else
+    Q_UNUSED(pid);
+    return false;
+#endif
+}
+
+} // namespace
+
+StageWatchdog::StageWatchdog(const QString &stage, int pages, qint64 inputBytes)
+    : m_stage(stage)
+    , m_pages(pages)
+    , m_inputBytes(inputBytes)
+    , m_pid(0)
+    , m_lastCpuTicks(-1)
+    , m_lastIoBytes(-1)
+    , m_lastOutputBytes(0)
+{
+    double deadlineMs = DEADLINE_SLACK_MS + DEADLINE_MARGIN * expectedMs(stage, pages, inputBytes);
+    m_deadlineMs = deadlineMs < INT_MAX ? int(deadlineMs) : INT_MAX;
+}
+
+double StageWatchdog::expectedMs(const QString &stage, int pages, qint64 inputBytes)
+{
+    const StageCost &cost = defaultCost(stage);
+    StageRates rates;
+    {
+        QMutexLocker locker(&historyMutex);
+        rates = stageRates(stage);
+    }
+    
+    double megabytes = inputBytes / (1024.0 * 1024.0);
+    return cost.overheadMs + qMax(pages * rates.msPerPage, megabytes * rates.msPerMegabyte);
+}
+
+void StageWatchdog::start(qint64 pid)
+{
+    m_pid = pid;
+    m_lastCpuTicks = processCpuTicks(pid);
+    m_lastIoBytes = processIoBytes(pid);
+    m_lastOutputBytes = 0;
+    m_reason.clear();
+    m_elapsed.start();
+    m_sinceProgress.start();
+}
+
+StageWatchdog::Verdict StageWatchdog::check(qint64 outputBytes)
+{
+    if (m_elapsed.elapsed() > m_deadlineMs) {
+        m_reason = QString("%1 did not finish within its %2 s deadline")
+                       .arg(m_stage).arg(m_deadlineMs / 1000.0, 0, 'f', 1);
+        return DeadlineExceeded;
+    }
+    
+    // Without /proc there is nothing to sample; rely on the deadline alone
+    qint64 cpuTicks = processCpuTicks(m_pid);
+    if (cpuTicks < 0) {
+        return Running;
+    }
+    
+    qint64 ioBytes = processIoBytes(m_pid);
+    if (cpuTicks != m_lastCpuTicks || ioBytes != m_lastIoBytes
+        || outputBytes != m_lastOutputBytes || waitingOnIo(m_pid)) {
+        m_lastCpuTicks = cpuTicks;
+        m_lastIoBytes = ioBytes;
+        m_lastOutputBytes = outputBytes;
+        m_sinceProgress.restart();
+    } else if (m_sinceProgress.elapsed() > stallTimeoutMs()) {
+        m_reason = QString("%1 stalled: no CPU or I/O progress for %2 s")
+                       .arg(m_stage).arg(m_sinceProgress.elapsed() / 1000);
+        return Stalled;
+    }
+    return Running;
+}
+
+void StageWatchdog::recordCompletion(qint64 wallMs) const
+{
+    const StageCost &cost = defaultCost(m_stage);
+    double workMs = qMax(0.0, wallMs - cost.overheadMs);
+    double megabytes = m_inputBytes / (1024.0 * 1024.0);
+    
+    QMutexLocker locker(&historyMutex);
+    StageRates &rates = stageRates(m_stage);
+    if (m_pages > 0) {
+        double observed = workMs / m_pages;
+        rates.msPerPage += HISTORY_WEIGHT * (observed - rates.msPerPage);
+    }
+    if (megabytes > 0) {
+        double observed = workMs / megabytes;
+        rates.msPerMegabyte += HISTORY_WEIGHT * (observed - rates.msPerMegabyte);
+    }
+    if (m_pages > 0 || megabytes > 0) {
+        changedStages.insert(m_stage);
+    }
+}
+
+void StageWatchdog::saveHistory()
+{
+    QMutexLocker locker(&historyMutex);
+    if (changedStages.isEmpty()) {
+        return;
+    }
+    QSettings settings;
+    for (const QString &stage : std::as_const(changedStages)) {
+        const StageRates &rates = history[stage];
+        settings.beginGroup(settingsGroup(stage));
+        settings.setValue("msPerPage", rates.msPerPage);
+        settings.setValue("msPerMegabyte", rates.msPerMegabyte);
+        settings.endGroup();
+    }
+    changedStages.clear();
+}
+
+int StageWatchdog::stallTimeoutMs()
+{
+    bool ok = false;
+    int seconds = qEnvironmentVariableIntValue("BOOKLET_STALL_SECONDS", &ok);
+    if (ok && seconds > 0) {
+        return seconds * 1000;
+    }
+    return 10000;
+}
+
+qint64 StageWatchdog::processCpuTicks(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile stat(QString("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    // pid (comm) state ppid ... utime stime cutime cstime; comm may contain
+    // spaces, so count fields from the closing parenthesis
+    QByteArray line = stat.readAll();
+    int commEnd = line.lastIndexOf(')');
+    if (commEnd < 0) {
+        return -1;
+    }
+    QList<QByteArray> fields = line.mid(commEnd + 2).split(' ');
+    if (fields.size() < 15) {
+        return -1;
+    }
+    // utime, stime, cutime and cstime are fields 14 to 17 of the full line
+    qint64 ticks = 0;
+    for (int field = 11; field <= 14; ++field) {
+        ticks += fields.at(field).toLongLong();
+    }
+    return ticks;
+#else
+    Q_UNUSED(pid);
+    return -1;
+#endif
+}
+
+qint64 StageWatchdog::processIoBytes(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile io(QString("/proc/%1/io").arg(pid));
+    if (!io.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    // Only changes matter, so every counter is summed: rchar and wchar see
+    // reads and writes served by the page cache or a network filesystem,
+    // read_bytes and write_bytes the ones that reached local storage
+    qint64 bytes = 0;
+    for (const QByteArray &line : io.readAll().split('\n')) {
+        int colon = line.indexOf(':');
+        if (colon > 0) {
+            bytes += line.mid(colon + 1).trimmed().toLongLong();
+        }
+    }
+    return bytes;
+#else
+    Q_UNUSED(pid);
+    return -1;
+#endif
+}
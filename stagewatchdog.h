@@ -0,0 +1,80 @@
+#ifndef STAGEWATCHDOG_H
+#define STAGEWATCHDOG_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+// Deadline and stall detection for one run of an external tool.
+//
+// The deadline scales with the work: a per-run overhead plus the larger of
+// pages * ms-per-page and megabytes * ms-per-megabyte, where the rates are
+// learned from earlier runs of the same stage and kept in QSettings. Large
+// documents get the time they need, while a child that stops using CPU,
+// writing output and doing I/O is declared stalled after stallTimeoutMs()
+// no matter how far off its deadline is. A child blocked in an I/O wait
+// (a cold disk, a slow network share) is left to the deadline.
+class StageWatchdog
+{
+public:
+    enum Verdict {
+        Running,
+        Stalled,
+        DeadlineExceeded
+    };
+    
+    StageWatchdog(const QString &stage, int pages = 0, qint64 inputBytes = 0);
+    
+    QString stage() const { return m_stage; }
+    int deadlineMs() const { return m_deadlineMs; }
+    
+    // Begin watching the started child
+    void start(qint64 pid);
+    // Sample the child; call every wait slice while it runs. Output the
+    // child has written so far counts as progress too, since it may be
+    // waiting on a helper of its own (pdflatex running mktexpk, say), and
+    // so do the bytes it has read and written.
+    Verdict check(qint64 outputBytes = 0);
+    // Why the last check() did not return Running
+    QString reason() const { return m_reason; }
+    
+    // Feed the duration of a successful run back into the stage history.
+    // Only call it for runs that succeeded: a tool that fails early would
+    // teach the stage a rate that kills healthy runs later. The rates are
+    // kept in memory until saveHistory().
+    void recordCompletion(qint64 wallMs) const;
+    
+    // Write the rates learned since the last call to QSettings; called
+    // once per job rather than once per run
+    static void saveHistory();
+    
+    // Expected duration of a run from the stage history
+    static double expectedMs(const QString &stage, int pages, qint64 inputBytes);
+    
+    // Time without CPU progress after which a child counts as stalled.
+    // Overridable with BOOKLET_STALL_SECONDS.
+    static int stallTimeoutMs();
+    
+    // User + system CPU ticks used so far by a running process and its
+    // reaped children, or -1 where that cannot be read
+    static qint64 processCpuTicks(qint64 pid);
+    
+    // Bytes a running process has read and written so far, through any
+    // file or pipe, or -1 where that cannot be read
+    static qint64 processIoBytes(qint64 pid);
+
+private:
+    QString m_stage;
+    int m_pages;
+    qint64 m_inputBytes;
+    int m_deadlineMs;
+    
+    qint64 m_pid;
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_sinceProgress;
+    qint64 m_lastCpuTicks;
+    qint64 m_lastIoBytes;
+    qint64 m_lastOutputBytes;
+    QString m_reason;
+};
+
+#endif // STAGEWATCHDOG_H
@@ -0,0 +1,200 @@
+#include "taskscheduler.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <exception>
+
+namespace {
+
+// Which pool, and which of its workers, the current thread is
+thread_local TaskScheduler *t_scheduler = nullptr;
+thread_local int t_workerIndex = -1;
+
+const int TICK_INTERVAL_MS = 100;
+
+} // namespace
+
+TaskScheduler::Group::Group(TaskScheduler &scheduler)
+    : m_scheduler(scheduler)
+{
+}
+
+TaskScheduler::Group::~Group()
+{
+    wait();
+}
+
+void TaskScheduler::Group::run(std::function<void()> task)
+{
+    m_pending.ref();
+    m_scheduler.push(Task{std::move(task), this});
+}
+
+void TaskScheduler::Group::wait(const std::function<void()> &tick)
+{
+    int self = t_scheduler == &m_scheduler ? t_workerIndex : -1;
+    QElapsedTimer tickTimer;
+    tickTimer.start();
+    
+    while (m_pending.loadAcquire() > 0) {
+        if (!m_scheduler.runOne(self)) {
+            // Everything left is running elsewhere
+            QMutexLocker locker(&m_scheduler.m_idleMutex);
+            if (m_pending.loadAcquire() > 0 && m_scheduler.m_queued.loadAcquire() == 0) {
+                m_scheduler.m_changed.wait(&m_scheduler.m_idleMutex, TICK_INTERVAL_MS);
+            }
+        }
+        if (tick && tickTimer.elapsed() >= TICK_INTERVAL_MS) {
+            tick();
+            tickTimer.restart();
+        }
+    }
+    
+    if (tick) {
+        tick();
+    }
+}
+
+TaskScheduler &TaskScheduler::instance()
+{
+    static TaskScheduler scheduler([]() {
+        bool ok;
+        int threads = qEnvironmentVariableIntValue("BOOKLET_TASK_THREADS", &ok);
+        return ok && threads > 0 ? threads : QThread::idealThreadCount();
+    }());
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler(int workers)
+    : m_stopping(false)
+{
+    for (int i = 0; i < qMax(1, workers); ++i) {
+        Worker *worker = new Worker;
+        worker->thread = QThread::create([this, i]() { workerLoop(i); });
+        worker->thread->setObjectName(QString("TaskWorker%1").arg(i));
+        m_workers.append(worker);
+    }
+    // Start only once every deque exists, since workers steal from all
+    for (Worker *worker : std::as_const(m_workers)) {
+        worker->thread->start();
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker locker(&m_idleMutex);
+        m_stopping = true;
+        m_changed.wakeAll();
+    }
+    for (Worker *worker : std::as_const(m_workers)) {
+        worker->thread->wait();
+        delete worker->thread;
+        delete worker;
+    }
+}
+
+void TaskScheduler::push(Task task)
+{
+    // A worker keeps what it spawns; other threads spread tasks round-robin
+    int index = t_scheduler == this && t_workerIndex >= 0
+        ? t_workerIndex
+        : m_nextWorker.fetchAndAddRelaxed(1) % m_workers.size();
+    if (index < 0) {
+        index += m_workers.size();
+    }
+    
+    // Counted before it is visible, so the count never goes negative
+    m_queued.ref();
+    Worker *worker = m_workers.at(index);
+    {
+        QMutexLocker locker(&worker->mutex);
+        worker->tasks.push_back(std::move(task));
+    }
+    
+    QMutexLocker locker(&m_idleMutex);
+    m_changed.wakeAll();
+}
+
+bool TaskScheduler::runOne(int self)
+{
+    Task task;
+    if ((self >= 0 && takeOwn(self, task)) || steal(self, task)) {
+        execute(task);
+        return true;
+    }
+    return false;
+}
+
+bool TaskScheduler::takeOwn(int self, Task &task)
+{
+    Worker *worker = m_workers.at(self);
+    QMutexLocker locker(&worker->mutex);
+    if (worker->tasks.empty()) {
+        return false;
+    }
+    // Newest first: its data is most likely still in this core's cache
+    task = std::move(worker->tasks.back());
+    worker->tasks.pop_back();
+    m_queued.deref();
+    return true;
+}
+
+bool TaskScheduler::steal(int self, Task &task)
+{
+    int count = m_workers.size();
+    int start = self >= 0 ? self + 1 : 0;
+    for (int offset = 0; offset < count; ++offset) {
+        int victim = (start + offset) % count;
+        if (victim == self) {
+            continue;
+        }
+        Worker *worker = m_workers.at(victim);
+        QMutexLocker locker(&worker->mutex);
+        if (worker->tasks.empty()) {
+            continue;
+        }
+        // Oldest first: usually the largest piece of work left
+        task = std::move(worker->tasks.front());
+        worker->tasks.pop_front();
+        m_queued.deref();
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::execute(Task &task)
+{
+    try {
+        task.function();
+    } catch (std::exception &e) {
+        qWarning() << "Task failed with exception:" << e.what();
+    } catch (...) {
+        qWarning() << "Task failed with an unknown exception";
+    }
+    
+    if (!task.group->m_pending.deref()) {
+        // Last task of its group: wake the thread waiting for it
+        QMutexLocker locker(&m_idleMutex);
+        m_changed.wakeAll();
+    }
+}
+
+void TaskScheduler::workerLoop(int index)
+{
+    t_scheduler = this;
+    t_workerIndex = index;
+    
+    while (true) {
+        if (runOne(index)) {
+            continue;
+        }
+        
+        QMutexLocker locker(&m_idleMutex);
+        if (m_stopping) {
+            return;
+        }
+        if (m_queued.loadAcquire() == 0) {
+            m_changed.wait(&m_idleMutex);
+        }
+    }
+}
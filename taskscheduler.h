@@ -0,0 +1,97 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Work-stealing thread pool shared by every job in the process.
+//
+// Jobs split their work (sheet ranges to compile, images to resample) into
+// tasks of a TaskScheduler::Group. Each worker keeps its own deque: tasks a
+// worker spawns go to the back of its deque and it takes its newest task
+// first, while idle workers steal the oldest task from another deque. A
+// thread waiting for its group runs queued tasks of any job instead of
+// sleeping, so the cores left idle by small jobs pick up sheets of a large
+// one and the batch as a whole finishes sooner.
+class TaskScheduler
+{
+public:
+    // Tasks of one job; the job waits for all of them at once
+    class Group
+    {
+    public:
+        explicit Group(TaskScheduler &scheduler = TaskScheduler::instance());
+        ~Group();
+        
+        void run(std::function<void()> task);
+        
+        // Help run queued tasks, of this or any other job, until every task
+        // of this group has finished. tick is called on the waiting thread
+        // between tasks, at most every 100 ms, e.g. to report progress.
+        void wait(const std::function<void()> &tick = std::function<void()>());
+    
+    private:
+        friend class TaskScheduler;
+        TaskScheduler &m_scheduler;
+        QAtomicInt m_pending;
+    };
+    
+    // Process-wide pool with one worker per core, or BOOKLET_TASK_THREADS
+    static TaskScheduler &instance();
+    
+    explicit TaskScheduler(int workers);
+    ~TaskScheduler();
+    
+    int workerCount() const { return m_workers.size(); }
+    
+    // Call fn on every item of items in parallel and wait, helping meanwhile
+    template <typename Container, typename Fn>
+    void map(Container &items, Fn fn)
+    {
+        Group group(*this);
+        for (auto &item : items) {
+            auto *itemPointer = &item;
+            group.run([fn, itemPointer]() { fn(*itemPointer); });
+        }
+        group.wait();
+    }
+
+private:
+    struct Task {
+        std::function<void()> function;
+        Group *group;
+    };
+    
+    struct Worker {
+        QMutex mutex;
+        std::deque<Task> tasks;
+        QThread *thread = nullptr;
+    };
+    
+    void push(Task task);
+    // Run one queued task: the calling worker's newest, else the oldest of
+    // another worker. self is -1 for threads outside the pool.
+    bool runOne(int self);
+    bool takeOwn(int self, Task &task);
+    bool steal(int self, Task &task);
+    void execute(Task &task);
+    void workerLoop(int index);
+    
+    QList<Worker *> m_workers;
+    QAtomicInt m_nextWorker;
+    QAtomicInt m_queued;
+    bool m_stopping;
+    
+    // Idle workers and waiting groups sleep here until work is pushed or a
+    // group's last task finishes
+    QMutex m_idleMutex;
+    QWaitCondition m_changed;
+};
+
+#endif // TASKSCHEDULER_H
@@ -0,0 +1,322 @@
+#include "toolprocess.h"
+#include <QDeadlineTimer>
+#include <QFile>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+// Both ends close on exec; the read end never blocks. The write end
+// becomes the child's stdout or stderr and stays blocking. Where pipe2
+// exists the ends are close-on-exec from the start, so a fork on another
+// thread cannot leak them into an unrelated child.
+bool makePipe(int fds[2])
+{
+#ifdef Q_OS_LINUX
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return false;
+    }
+#else
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void closeDescriptor(int &fd)
+{
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+} // namespace
+
+ToolProcess::ToolProcess()
+    : m_throughHelper(false)
+    , m_hasEnvironment(false)
+    , m_replyFd(-1)
+    , m_stdoutFd(-1)
+    , m_stderrFd(-1)
+    , m_pid(0)
+    , m_started(false)
+    , m_exited(false)
+    , m_exitCode(0)
+    , m_exitStatus(QProcess::NormalExit)
+{
+    std::memset(&m_usage, 0, sizeof(m_usage));
+}
+
+ToolProcess::~ToolProcess()
+{
+    // Like QProcess, never leave a child running behind
+    if (m_throughHelper && m_started && !m_exited) {
+        kill();
+        waitForFinished(1000);
+    }
+    closeDescriptors();
+}
+
+void ToolProcess::setWorkingDirectory(const QString &dir)
+{
+    m_workingDirectory = dir;
+    m_process.setWorkingDirectory(dir);
+}
+
+void ToolProcess::setProcessEnvironment(const QProcessEnvironment &environment)
+{
+    m_environment = environment;
+    m_hasEnvironment = true;
+    m_process.setProcessEnvironment(environment);
+}
+
+void ToolProcess::start(const QString &program, const QStringList &args)
+{
+    m_program = program;
+    m_args = args;
+    
+    m_throughHelper = SpawnHelper::isRunning() && requestFromHelper();
+    if (!m_throughHelper) {
+        startDirectly();
+    }
+}
+
+bool ToolProcess::requestFromHelper()
+{
+    int stdoutPipe[2];
+    int stderrPipe[2];
+    if (!makePipe(stdoutPipe)) {
+        return false;
+    }
+    if (!makePipe(stderrPipe)) {
+        close(stdoutPipe[0]);
+        close(stdoutPipe[1]);
+        return false;
+    }
+    
+    // Same encodings QProcess uses
+    QList<QByteArray> args;
+    for (const QString &arg : std::as_const(m_args)) {
+        args << arg.toLocal8Bit();
+    }
+    QList<QByteArray> environment;
+    if (m_hasEnvironment) {
+        for (const QString &entry : m_environment.toStringList()) {
+            environment << entry.toLocal8Bit();
+        }
+    }
+    
+    bool sent = SpawnHelper::request(QFile::encodeName(m_program), args,
+                                     QFile::encodeName(m_workingDirectory),
+                                     m_hasEnvironment ? &environment : nullptr,
+                                     stdoutPipe[1], stderrPipe[1], m_replyFd);
+    // The helper has its own copies of the write ends now
+    close(stdoutPipe[1]);
+    close(stderrPipe[1]);
+    m_stdoutFd = stdoutPipe[0];
+    m_stderrFd = stderrPipe[0];
+    if (!sent) {
+        closeDescriptors();
+    }
+    return sent;
+}
+
+void ToolProcess::startDirectly()
+{
+    m_throughHelper = false;
+    m_process.start(m_program, m_args);
+}
+
+bool ToolProcess::waitForStarted(int msecs)
+{
+    if (!m_throughHelper) {
+        return m_process.waitForStarted(msecs);
+    }
+    if (m_started) {
+        return true;
+    }
+    if (m_replyFd < 0) {
+        return false;
+    }
+    
+    SpawnHelper::Reply reply;
+    if (!SpawnHelper::readReply(m_replyFd, msecs, reply) || reply.kind != SpawnHelper::Started) {
+        m_error = "The spawn helper did not start " + m_program;
+        closeDescriptors();
+        return false;
+    }
+    if (reply.error == ENOSYS) {
+        // The helper cannot change directory on this system
+        closeDescriptors();
+        startDirectly();
+        return m_process.waitForStarted(msecs);
+    }
+    if (reply.error != 0) {
+        m_error = QString("Failed to start %1: %2").arg(m_program, std::strerror(reply.error));
+        closeDescriptors();
+        return false;
+    }
+    
+    m_pid = reply.pid;
+    m_started = true;
+    return true;
+}
+
+bool ToolProcess::waitForFinished(int msecs)
+{
+    if (!m_throughHelper) {
+        return m_process.waitForFinished(msecs);
+    }
+    
+    QDeadlineTimer deadline(msecs);
+    if (!m_started && !waitForStarted(msecs)) {
+        return false;
+    }
+    if (m_exited) {
+        return false;
+    }
+    
+    while (true) {
+        // Keep the pipes drained so the child never blocks on a full one
+        struct pollfd fds[3];
+        nfds_t count = 0;
+        fds[count++] = { m_replyFd, POLLIN, 0 };
+        if (m_stdoutFd >= 0) {
+            fds[count++] = { m_stdoutFd, POLLIN, 0 };
+        }
+        if (m_stderrFd >= 0) {
+            fds[count++] = { m_stderrFd, POLLIN, 0 };
+        }
+        
+        int ready = poll(fds, count, deadline.isForever() ? -1 : int(deadline.remainingTime()));
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+        readPipes();
+        
+        if (ready > 0 && fds[0].revents) {
+            SpawnHelper::Reply reply;
+            m_exited = true;
+            if (SpawnHelper::readReply(m_replyFd, 0, reply) && reply.kind == SpawnHelper::Exited) {
+                m_usage = reply.usage;
+                if (WIFEXITED(reply.status)) {
+                    m_exitCode = WEXITSTATUS(reply.status);
+                } else {
+                    m_exitStatus = QProcess::CrashExit;
+                    m_error = "Process crashed";
+                }
+            } else {
+                m_exitStatus = QProcess::CrashExit;
+                m_error = "The spawn helper went away while " + m_program + " ran";
+            }
+            readPipes();
+            closeDescriptors();
+            return true;
+        }
+        if (deadline.hasExpired()) {
+            return false;
+        }
+    }
+}
+
+QProcess::ProcessState ToolProcess::state() const
+{
+    if (!m_throughHelper) {
+        return m_process.state();
+    }
+    if (m_exited || (m_replyFd < 0 && !m_started)) {
+        return QProcess::NotRunning;
+    }
+    return m_started ? QProcess::Running : QProcess::Starting;
+}
+
+qint64 ToolProcess::processId() const
+{
+    return m_throughHelper ? m_pid : m_process.processId();
+}
+
+void ToolProcess::kill()
+{
+    if (!m_throughHelper) {
+        m_process.kill();
+    } else if (m_started && !m_exited && m_replyFd >= 0) {
+        // The helper reaps the child before it sends Exited, so the pid
+        // may already belong to another process; only the helper knows
+        SpawnHelper::signalChild(m_replyFd, SIGKILL);
+    }
+}
+
+QByteArray ToolProcess::readAllStandardOutput()
+{
+    if (!m_throughHelper) {
+        return m_process.readAllStandardOutput();
+    }
+    readPipes();
+    return std::exchange(m_stdout, QByteArray());
+}
+
+QByteArray ToolProcess::readAllStandardError()
+{
+    if (!m_throughHelper) {
+        return m_process.readAllStandardError();
+    }
+    readPipes();
+    return std::exchange(m_stderr, QByteArray());
+}
+
+int ToolProcess::exitCode() const
+{
+    return m_throughHelper ? m_exitCode : m_process.exitCode();
+}
+
+QProcess::ExitStatus ToolProcess::exitStatus() const
+{
+    return m_throughHelper ? m_exitStatus : m_process.exitStatus();
+}
+
+QString ToolProcess::errorString() const
+{
+    if (!m_throughHelper) {
+        return m_process.errorString();
+    }
+    return m_error.isEmpty() ? QString("Unknown error") : m_error;
+}
+
+void ToolProcess::readPipes()
+{
+    char chunk[65536];
+    int *fds[] = { &m_stdoutFd, &m_stderrFd };
+    QByteArray *buffers[] = { &m_stdout, &m_stderr };
+    for (int i = 0; i < 2; ++i) {
+        while (*fds[i] >= 0) {
+            ssize_t length = read(*fds[i], chunk, sizeof(chunk));
+            if (length > 0) {
+                buffers[i]->append(chunk, length);
+            } else if (length == 0 || errno != EINTR) {
+                // End of output, or nothing more for now
+                if (length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    closeDescriptor(*fds[i]);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void ToolProcess::closeDescriptors()
+{
+    closeDescriptor(m_replyFd);
+    closeDescriptor(m_stdoutFd);
+    closeDescriptor(m_stderrFd);
+}
@@ -0,0 +1,81 @@
+#ifndef TOOLPROCESS_H
+#define TOOLPROCESS_H
+
+#include "spawnhelper.h"
+#include <QByteArray>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+#include <sys/resource.h>
+
+// One run of an external tool. It starts through SpawnHelper when the
+// helper is running and through QProcess otherwise.
+//
+// Offers the part of the QProcess interface that runTool and the
+// PathConfig probes use, so callers need not know how the child was
+// started. As with QProcess, output is collected while waitForFinished
+// waits.
+class ToolProcess
+{
+public:
+    ToolProcess();
+    ~ToolProcess();
+    ToolProcess(const ToolProcess &) = delete;
+    ToolProcess &operator=(const ToolProcess &) = delete;
+    
+    void setWorkingDirectory(const QString &dir);
+    QString workingDirectory() const { return m_workingDirectory; }
+    void setProcessEnvironment(const QProcessEnvironment &environment);
+    
+    void start(const QString &program, const QStringList &args);
+    bool waitForStarted(int msecs = 30000);
+    bool waitForFinished(int msecs = 30000);
+    QProcess::ProcessState state() const;
+    qint64 processId() const;
+    void kill();
+    
+    QByteArray readAllStandardOutput();
+    QByteArray readAllStandardError();
+    
+    int exitCode() const;
+    QProcess::ExitStatus exitStatus() const;
+    QString errorString() const;
+    
+    // True once a child started through the helper has exited. usage() is
+    // then its own resource use from wait4, rather than the sum of all
+    // reaped children that getrusage gives.
+    bool hasUsage() const { return m_throughHelper && m_exited; }
+    const struct rusage &usage() const { return m_usage; }
+
+private:
+    bool requestFromHelper();
+    void startDirectly();
+    // Move whatever the pipes hold into the buffers without blocking
+    void readPipes();
+    void closeDescriptors();
+    
+    QProcess m_process;             // used when the helper is not
+    bool m_throughHelper;
+    
+    QString m_program;
+    QStringList m_args;
+    QString m_workingDirectory;
+    QProcessEnvironment m_environment;
+    bool m_hasEnvironment;
+    
+    int m_replyFd;
+    int m_stdoutFd;
+    int m_stderrFd;
+    qint64 m_pid;
+    bool m_started;
+    bool m_exited;
+    int m_exitCode;
+    QProcess::ExitStatus m_exitStatus;
+    struct rusage m_usage;
+    QString m_error;
+    QByteArray m_stdout;
+    QByteArray m_stderr;
+};
+
+#endif // TOOLPROCESS_H